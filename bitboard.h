@@ -0,0 +1,449 @@
+#pragma once
+// 墙位图上的按字并行查询：一次处理一行里的 64 个格子。
+// 邻居用移位得到（跨字的那一位从相邻的字借过来），计数用 popcount；编译时打开 AVX2（-mavx2）
+// 的话，面、死胡同和岔路口的统计每次处理 4 个字。连通分量和最短路同样按字并行地一次走 64 格。
+#include "define.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define WALL_FACE_NORTH 1   // 朝第 i-1 行
+#define WALL_FACE_SOUTH 2   // 朝第 i+1 行
+#define WALL_FACE_WEST  4   // 朝第 j-1 列
+#define WALL_FACE_EAST  8   // 朝第 j+1 列
+#define WALL_FACE_SIDES 15
+#define WALL_FACE_TOP   16
+#define WALL_FACE_BOTTOM 32
+#define WALL_FACE_ALL   63
+
+inline int bitCount(uint64_t x) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+// 最低的 1 在第几位；x 不能是 0
+inline int bitLowest(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long k;
+    _BitScanForward64(&k, x);
+    return (int)k;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// 第 k 个字里属于地图的位
+inline uint64_t bitValidMask(const Map& m, size_t k) {
+    if (k + 1 < m.blocks.wallStride || m.width % 64 == 0) return ~0ull;
+    return (1ull << (m.width % 64)) - 1;
+}
+
+// 一个字里 64 个格子自己和四个邻居是不是墙；地图外按 outsideIsWall 处理。结果只有 valid 里的位有意义
+struct BitNeighbours {
+    uint64_t self, north, south, west, east, valid;
+};
+
+inline BitNeighbours bitNeighbours(const Map& m, int i, size_t k, bool outsideIsWall) {
+    BitNeighbours n;
+    size_t words = m.blocks.wallStride;
+    const uint64_t* row = m.blocks.wallRow(i);
+    uint64_t outside = outsideIsWall ? ~0ull : 0ull;
+    n.valid = bitValidMask(m, k);
+    n.self = row[k];
+    uint64_t cur = row[k] | (outside & ~n.valid);     // 行尾之外的位当作地图外
+    n.north = i > 0 ? m.blocks.wallRow(i - 1)[k] : outside;
+    n.south = i + 1 < m.height ? m.blocks.wallRow(i + 1)[k] : outside;
+    n.west = (cur << 1) | (k > 0 ? row[k - 1] >> 63 : (outside & 1));
+    n.east = (cur >> 1) | (k + 1 < words ? row[k + 1] << 63 : (outside << 63));
+    return n;
+}
+
+// 单个墙格子需要画的面：顶面，加上邻居不是墙的侧面（地图外算空地）；底面贴着地面，永远看不到
+inline int wallFaceMask(const Map& m, int i, int j) {
+    int mask = WALL_FACE_TOP;
+    if (i == 0 || !m.blocks.isWall(i - 1, j)) mask |= WALL_FACE_NORTH;
+    if (i + 1 == m.height || !m.blocks.isWall(i + 1, j)) mask |= WALL_FACE_SOUTH;
+    if (j == 0 || !m.blocks.isWall(i, j - 1)) mask |= WALL_FACE_WEST;
+    if (j + 1 == m.width || !m.blocks.isWall(i, j + 1)) mask |= WALL_FACE_EAST;
+    return mask;
+}
+
+#ifdef __AVX2__
+// 每个 64 位通道的 popcount（查表法），结果累加成 4 个 64 位和
+inline __m256i bitCount256(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+inline long long bitSum256(__m256i v) {
+    return _mm256_extract_epi64(v, 0) + _mm256_extract_epi64(v, 1) +
+           _mm256_extract_epi64(v, 2) + _mm256_extract_epi64(v, 3);
+}
+#endif
+
+// 对每个字调用 scalar(邻居) 或 vector(self, north, south, west, east)，把返回的位数加起来。
+// AVX2 版本处理行中间完整的字（需要左右各一个相邻字），行首行尾仍走标量。
+template <typename ScalarKernel, typename VectorKernel>
+long long bitCountRows(const Map& m, bool outsideIsWall, ScalarKernel scalar, VectorKernel vector) {
+    long long total = 0;
+    size_t words = m.blocks.wallStride;
+    for (int i = 0; i < m.height; i++) {
+        size_t k = 0;
+#ifdef __AVX2__
+        if (i > 0 && i + 1 < m.height && words > 5) {
+            const uint64_t* row = m.blocks.wallRow(i);
+            const uint64_t* up = m.blocks.wallRow(i - 1);
+            const uint64_t* down = m.blocks.wallRow(i + 1);
+            BitNeighbours n = bitNeighbours(m, i, 0, outsideIsWall);
+            total += bitCount(scalar(n) & n.valid);
+            __m256i acc = _mm256_setzero_si256();
+            for (k = 1; k + 4 < words; k += 4) {
+                __m256i self = _mm256_loadu_si256((const __m256i*)(row + k));
+                __m256i prev = _mm256_loadu_si256((const __m256i*)(row + k - 1));
+                __m256i next = _mm256_loadu_si256((const __m256i*)(row + k + 1));
+                __m256i north = _mm256_loadu_si256((const __m256i*)(up + k));
+                __m256i south = _mm256_loadu_si256((const __m256i*)(down + k));
+                __m256i west = _mm256_or_si256(_mm256_slli_epi64(self, 1), _mm256_srli_epi64(prev, 63));
+                __m256i east = _mm256_or_si256(_mm256_srli_epi64(self, 1), _mm256_slli_epi64(next, 63));
+                acc = _mm256_add_epi64(acc, bitCount256(vector(self, north, south, west, east)));
+            }
+            total += bitSum256(acc);
+        }
+#else
+        (void)vector;
+#endif
+        for (; k < words; k++) {
+            BitNeighbours n = bitNeighbours(m, i, k, outsideIsWall);
+            total += bitCount(scalar(n) & n.valid);
+        }
+    }
+    return total;
+}
+
+// 所有墙的可见侧面数（地图外算空地），即逐格绘制时真正需要画的侧面
+inline long long bitExposedFaces(const Map& m) {
+    long long faces = 0;
+    for (int side = 0; side < 4; side++) {
+        faces += bitCountRows(m, false,
+            [side](const BitNeighbours& n) {
+                uint64_t other = side == 0 ? n.north : side == 1 ? n.south : side == 2 ? n.west : n.east;
+                return n.self & ~other & n.valid;
+            },
+#ifdef __AVX2__
+            [side](__m256i self, __m256i north, __m256i south, __m256i west, __m256i east) {
+                __m256i other = side == 0 ? north : side == 1 ? south : side == 2 ? west : east;
+                return _mm256_andnot_si256(other, self);
+            }
+#else
+            0
+#endif
+        );
+    }
+    return faces;
+}
+
+// 四个位图逐位相加，返回“恰好等于 3”的位
+inline uint64_t bitExactlyThree(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    uint64_t s1 = a ^ b, c1 = a & b;
+    uint64_t s2 = c ^ d, c2 = c & d;
+    uint64_t bit0 = s1 ^ s2, carry = s1 & s2;
+    uint64_t bit1 = c1 ^ c2 ^ carry;
+    uint64_t bit2 = (c1 & c2) | ((c1 ^ c2) & carry);
+    return bit0 & bit1 & ~bit2;
+}
+
+// 死胡同：三面是墙的空地（地图外算墙）
+inline long long bitDeadEnds(const Map& m) {
+    return bitCountRows(m, true,
+        [](const BitNeighbours& n) {
+            return ~n.self & bitExactlyThree(n.north, n.south, n.west, n.east) & n.valid;
+        },
+#ifdef __AVX2__
+        [](__m256i self, __m256i north, __m256i south, __m256i west, __m256i east) {
+            __m256i s1 = _mm256_xor_si256(north, south), c1 = _mm256_and_si256(north, south);
+            __m256i s2 = _mm256_xor_si256(west, east), c2 = _mm256_and_si256(west, east);
+            __m256i bit0 = _mm256_xor_si256(s1, s2), carry = _mm256_and_si256(s1, s2);
+            __m256i bit1 = _mm256_xor_si256(_mm256_xor_si256(c1, c2), carry);
+            __m256i bit2 = _mm256_or_si256(_mm256_and_si256(c1, c2),
+                                           _mm256_and_si256(_mm256_xor_si256(c1, c2), carry));
+            return _mm256_andnot_si256(_mm256_or_si256(self, bit2), _mm256_and_si256(bit0, bit1));
+        }
+#else
+        0
+#endif
+    );
+}
+
+// 四个位图逐位相加，返回“不超过 1”的位
+inline uint64_t bitAtMostOne(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    return ~((a & b) | (c & d) | ((a ^ b) & (c ^ d)));
+}
+
+// 岔路口：至少三个方向可走的空地，即四周最多一面墙（地图外算墙）
+inline long long bitJunctions(const Map& m) {
+    return bitCountRows(m, true,
+        [](const BitNeighbours& n) {
+            return ~n.self & bitAtMostOne(n.north, n.south, n.west, n.east) & n.valid;
+        },
+#ifdef __AVX2__
+        [](__m256i self, __m256i north, __m256i south, __m256i west, __m256i east) {
+            __m256i two = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(north, south), _mm256_and_si256(west, east)),
+                                          _mm256_and_si256(_mm256_xor_si256(north, south), _mm256_xor_si256(west, east)));
+            return _mm256_andnot_si256(_mm256_or_si256(self, two), _mm256_set1_epi64x(-1));
+        }
+#else
+        0
+#endif
+    );
+}
+
+// ---------------- 连通性 ----------------
+inline uint64_t bitReverse(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+    x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+// 把种子 x 沿着 open 中连续的 1 向高位扩展到段尾：o + x 的进位会一路穿过种子上方的整段
+inline void bitFillUp(uint64_t* x, const uint64_t* open, size_t words) {
+    uint64_t carry = 0;
+    for (size_t k = 0; k < words; k++) {
+        uint64_t seed = x[k] & open[k];
+        uint64_t sum = open[k] + seed;
+        uint64_t c1 = sum < open[k];
+        uint64_t sum2 = sum + carry;
+        uint64_t c2 = sum2 < sum;
+        x[k] = ((sum2 ^ open[k]) | seed) & open[k];
+        carry = c1 | c2;
+    }
+}
+
+// 把一行里的种子扩展成它们所在的整段空地：先向高位扩展，再把整行位序反过来向高位扩展一次
+inline void bitFillRow(uint64_t* x, const uint64_t* open, size_t words, uint64_t* scratch) {
+    bitFillUp(x, open, words);
+    uint64_t* rx = scratch;
+    uint64_t* ro = scratch + words;
+    for (size_t k = 0; k < words; k++) {
+        rx[k] = bitReverse(x[words - 1 - k]);
+        ro[k] = bitReverse(open[words - 1 - k]);
+    }
+    bitFillUp(rx, ro, words);
+    for (size_t k = 0; k < words; k++) x[k] |= bitReverse(rx[words - 1 - k]);
+}
+
+// 从 (si, sj) 出发的四连通洪水填充，reach 得到可到达格子的位图（布局同墙位图），返回可到达的格子数。
+// 按行处理：某一行有新的格子被填上，就把上下两行连同变化的字的范围放回待处理队列，
+// 下一次只看这个范围（加上横向延伸出去的字），直到没有变化。
+inline long long bitFloodFill(const Map& m, int si, int sj, std::vector<uint64_t>& reach) {
+    size_t words = m.blocks.wallStride;
+    reach.assign(words * m.height, 0);
+    if (si < 0 || sj < 0 || si >= m.height || sj >= m.width || m.blocks.isWall(si, sj)) return 0;
+
+    std::vector<uint64_t> open(words), cand(words), scratch(words * 2);
+    std::vector<int> queue;
+    std::vector<int> dirtyLo(m.height, (int)words), dirtyHi(m.height, -1);
+    auto push = [&](int i, int lo, int hi) {
+        if (i < 0 || i >= m.height) return;
+        if (dirtyHi[i] < 0) queue.push_back(i);
+        dirtyLo[i] = std::min(dirtyLo[i], lo);
+        dirtyHi[i] = std::max(dirtyHi[i], hi);
+    };
+    // 单个字内的填充（种子只在这一个字里）
+    auto fillWord = [&](int k) {
+        bitFillRow(&cand[k], &open[k], 1, scratch.data());
+    };
+
+    int k0 = sj / 64;
+    reach[si * words + k0] = 1ull << (sj % 64);
+    push(si, k0, k0);
+    bool first = true;
+    while (!queue.empty()) {
+        int i = queue.back();
+        queue.pop_back();
+        int lo = dirtyLo[i], hi = dirtyHi[i];
+        dirtyLo[i] = (int)words;
+        dirtyHi[i] = -1;
+
+        uint64_t* row = &reach[i * words];
+        const uint64_t* walls = m.blocks.wallRow(i);
+        const uint64_t* up = i > 0 ? &reach[(i - 1) * words] : NULL;
+        const uint64_t* down = i + 1 < m.height ? &reach[(i + 1) * words] : NULL;
+        int changedLo = (int)words, changedHi = -1;
+        for (int k = lo; k <= hi; k++) {
+            open[k] = ~walls[k] & bitValidMask(m, k);
+            uint64_t from = (up ? up[k] : 0) | (down ? down[k] : 0);
+            cand[k] = row[k] | (from & open[k]);
+            if (cand[k] != row[k] || first) {
+                changedLo = std::min(changedLo, k);
+                changedHi = std::max(changedHi, k);
+            }
+        }
+        first = false;
+        if (changedHi < 0) continue;
+
+        // 先在有新种子的字里横向填充，再看空地段是否跨过字的边界，跨过就把相邻的字也填上
+        lo = changedLo;
+        hi = changedHi;
+        bitFillRow(&cand[lo], &open[lo], hi - lo + 1, scratch.data());
+        while (hi + 1 < (int)words && (cand[hi] >> 63) && !(row[hi + 1] & 1) &&
+               (~walls[hi + 1] & bitValidMask(m, hi + 1) & 1)) {
+            hi++;
+            open[hi] = ~walls[hi] & bitValidMask(m, hi);
+            cand[hi] = row[hi] | 1;
+            fillWord(hi);
+        }
+        while (lo > 0 && (cand[lo] & 1) && !(row[lo - 1] >> 63) && ((~walls[lo - 1] >> 63) & 1)) {
+            lo--;
+            open[lo] = ~walls[lo];
+            cand[lo] = row[lo] | (1ull << 63);
+            fillWord(lo);
+        }
+        for (int k = lo; k <= hi; k++) row[k] = cand[k];
+        push(i - 1, lo, hi);
+        push(i + 1, lo, hi);
+    }
+
+    long long count = 0;
+    for (size_t k = 0; k < reach.size(); k++) count += bitCount(reach[k]);
+    return count;
+}
+
+// ---------------- 按层的洪水填充 ----------------
+// 位并行的广度优先搜索：前沿只记有新格子的字，一个字里的格子一次向四个方向各走一步，
+// 走过的格子从 free 里清掉。free 每行多一个全 0 的字、上下各多一行全 0，
+// 越过行首行尾或地图上下边的位都落在 0 上，内层循环不用判断边界。
+struct BitLayerFlood {
+    struct Front {
+        size_t index;
+        uint64_t bits;
+    };
+    size_t words, stride;
+    std::vector<uint64_t> free;     // 还没走到的空地
+    std::vector<Front> cur, next;
+    long long open;                 // 空地总数
+
+    explicit BitLayerFlood(const Map& m)
+        : words(m.blocks.wallStride), stride(words + 1), free((m.height + 2) * stride, 0), open(0) {
+        for (int i = 0; i < m.height; i++) {
+            const uint64_t* walls = m.blocks.wallRow(i);
+            for (size_t k = 0; k < words; k++) {
+                free[(i + 1) * stride + k] = ~walls[k] & bitValidMask(m, k);
+                open += bitCount(free[(i + 1) * stride + k]);
+            }
+        }
+    }
+
+    size_t index(int i, int j) const { return (i + 1) * stride + j / 64; }
+    bool isFree(int i, int j) const { return (free[index(i, j)] >> (j % 64)) & 1; }
+
+    long long remaining() const {
+        long long count = 0;
+        for (size_t k = 0; k < free.size(); k++) count += bitCount(free[k]);
+        return count;
+    }
+
+    // 从 (si, sj) 填满它所在的连通区域；(ti, tj) 在第几层被走到就返回几（即最短步数），
+    // 没走到或 ti < 0 返回 -1。(si, sj) 必须是还没走到的空地
+    int fill(int si, int sj, int ti, int tj) {
+        size_t target = ti >= 0 ? index(ti, tj) : 0;
+        uint64_t targetBit = ti >= 0 && isFree(ti, tj) ? 1ull << (tj % 64) : 0;
+        int found = -1;
+        cur.resize(1);
+        cur[0].index = index(si, sj);
+        cur[0].bits = 1ull << (sj % 64);
+        free[cur[0].index] ^= cur[0].bits;
+        size_t count = 1;
+        for (int layer = 0; count > 0; layer++) {
+            if (found < 0 && targetBit && !(free[target] & targetBit)) found = layer;
+            // 每项最多产生 5 项；先留够位置，写的时候就不用判断，没有新格子的项下一次写入时覆盖掉
+            if (next.size() < count * 5) next.resize(count * 5);
+            Front* out = next.data();
+            uint64_t* f = free.data();
+            size_t n = 0;
+            auto step = [&](size_t k, uint64_t bits) {
+                bits &= f[k];
+                f[k] ^= bits;
+                out[n].index = k;
+                out[n].bits = bits;
+                n += bits != 0;
+            };
+            for (size_t c = 0; c < count; c++) {
+                size_t k = cur[c].index;
+                uint64_t bits = cur[c].bits;
+                step(k, (bits << 1) | (bits >> 1));
+                if (bits & 1) step(k - 1, 1ull << 63);
+                if (bits >> 63) step(k + 1, 1);
+                step(k - stride, bits);
+                step(k + stride, bits);
+            }
+            cur.swap(next);
+            count = n;
+        }
+        return found;
+    }
+};
+
+// 起点到终点的最短步数，到不了返回 -1
+inline int bitShortestPath(const Map& m, int si, int sj, int ei, int ej) {
+    if (si < 0 || sj < 0 || si >= m.height || sj >= m.width || m.blocks.isWall(si, sj)) return -1;
+    if (ei < 0 || ej < 0 || ei >= m.height || ej >= m.width) return -1;
+    return BitLayerFlood(m).fill(si, sj, ei, ej);
+}
+
+// ---------------- 加载时的分析 ----------------
+struct MapAnalysis {
+    long long open;         // 空地格子数
+    long long components;   // 空地的四连通分量数
+    long long reachable;    // 从起点能走到的格子数
+    long long deadEnds, junctions;
+    bool hasStart, hasEnd;
+    int pathLength;         // 起点到终点的最短步数，到不了是 -1
+};
+
+// 从起点按层填充一遍，顺带得到终点的步数和起点能到的格子数；
+// 剩下没走到的空地每次挑一格再填一遍，填了几次就多几个分量
+inline MapAnalysis mapAnalyze(const Map& m) {
+    MapAnalysis a;
+    memset(&a, 0, sizeof(a));
+    a.pathLength = -1;
+    BitLayerFlood flood(m);
+    a.open = flood.open;
+
+    GLint si = -1, sj = -1, ei = -1, ej = -1;
+    a.hasStart = m.findMarker(MAP_BLOCK_START, si, sj);
+    a.hasEnd = m.findMarker(MAP_BLOCK_END, ei, ej);
+    if (a.hasStart && flood.isFree(si, sj)) {
+        a.pathLength = flood.fill(si, sj, a.hasEnd ? ei : -1, ej);
+        a.components = 1;
+        a.reachable = a.open - flood.remaining();
+    }
+    for (size_t k = 0; k < flood.free.size(); k++) {
+        while (flood.free[k]) {
+            int i = (int)(k / flood.stride) - 1;
+            int j = (int)(k % flood.stride) * 64 + bitLowest(flood.free[k]);
+            flood.fill(i, j, -1, 0);
+            a.components++;
+        }
+    }
+    a.deadEnds = bitDeadEnds(m);
+    a.junctions = bitJunctions(m);
+    return a;
+}
@@ -0,0 +1,101 @@
+#pragma once
+// 按块压缩格子：块内每行先和上面第 period 行异或（迷宫里上下相邻的行大多相同或只差几格；
+// 房间在奇数坐标上的迷宫隔一行更像），再把得到的字节流做游程编码（PackBits）。
+// 每块单独压缩，解压任何一块都不需要别的块。
+//
+// 控制字节 c：
+//   c < 128   后面跟 c+1 个原样的字节
+//   c >= 128  后面跟 1 个字节，重复 c-125 次（3 到 130 次）
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define RLE_MAX_LITERAL 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN 130
+
+// rows 行、每行 rowWords 个字，压缩结果追加到 out 后面，返回追加的字节数
+inline size_t rleCompressRows(const uint64_t* words, size_t rows, size_t rowWords, size_t period,
+                              std::vector<uint8_t>& out) {
+    size_t total = rows * rowWords * 8;
+    std::vector<uint8_t> delta(total);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t w = 0; w < rowWords; w++) {
+            uint64_t v = words[r * rowWords + w];
+            if (r >= period) v ^= words[(r - period) * rowWords + w];
+            memcpy(&delta[(r * rowWords + w) * 8], &v, 8);
+        }
+    }
+
+    size_t start = out.size();
+    size_t k = 0, literal = 0;     // [literal, k) 是还没写出的原样字节
+    auto flushLiteral = [&](size_t end) {
+        while (literal < end) {
+            size_t n = std::min((size_t)RLE_MAX_LITERAL, end - literal);
+            out.push_back((uint8_t)(n - 1));
+            out.insert(out.end(), delta.begin() + literal, delta.begin() + literal + n);
+            literal += n;
+        }
+    };
+    while (k < total) {
+        size_t run = 1;
+        while (k + run < total && run < RLE_MAX_RUN && delta[k + run] == delta[k]) run++;
+        // 夹在原样字节中间的 3 字节游程不比原样存放短，只会让解压时多一次分支
+        if (run < RLE_MIN_RUN || (run == RLE_MIN_RUN && literal < k)) {
+            k += run;
+            continue;
+        }
+        flushLiteral(k);
+        out.push_back((uint8_t)(run + 125));
+        out.push_back(delta[k]);
+        k += run;
+        literal = k;
+    }
+    flushLiteral(total);
+    return out.size() - start;
+}
+
+// 解压到 words（rows * rowWords 个字）；数据不完整或多出字节时返回 false
+inline bool rleDecompressRows(const uint8_t* src, size_t size, uint64_t* words, size_t rows, size_t rowWords,
+                              size_t period) {
+    uint8_t* dst = (uint8_t*)words;
+    const uint8_t* end = src + size;
+    size_t total = rows * rowWords * 8, pos = 0;
+    while (pos < total) {
+        if (src >= end) return false;
+        unsigned c = *src++;
+        // 片段都很短，按 8 字节一段自己拷贝，比调用变长的 memcpy/memset 快得多
+        size_t n, k = 0;
+        if (c < 128) {
+            n = c + 1;
+            if (n > total - pos || n > (size_t)(end - src)) return false;
+            for (; k + 8 <= n; k += 8) {
+                uint64_t v;
+                memcpy(&v, src + k, 8);
+                memcpy(dst + pos + k, &v, 8);
+            }
+            for (; k < n; k++) dst[pos + k] = src[k];
+            src += n;
+        } else {
+            n = c - 125;
+            if (n > total - pos || src >= end) return false;
+            uint64_t v = *src++ * 0x0101010101010101ull;
+            for (; k + 8 <= n; k += 8) memcpy(dst + pos + k, &v, 8);
+            for (; k < n; k++) dst[pos + k] = (uint8_t)v;
+        }
+        pos += n;
+    }
+    // 异或链放在寄存器里累加，不必每行都从刚写回的内存里再读一遍
+    for (size_t w = 0; w < rowWords; w++) {
+        for (size_t phase = 0; phase < period && phase < rows; phase++) {
+            uint64_t acc = 0;
+            for (size_t r = phase; r < rows; r += period) {
+                acc ^= words[r * rowWords + w];
+                words[r * rowWords + w] = acc;
+            }
+        }
+    }
+    return src == end;
+}
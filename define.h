@@ -1,5 +1,10 @@
 #pragma once
 #include <OpenGL/gl.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 #define WINDOW_POSITION_X 100
 #define WINDOW_POSITION_Y 100
@@ -13,12 +18,269 @@ struct Color { GLfloat r,g,b; };
 #define MAP_BLOCK_START 2
 #define MAP_BLOCK_END   3
 
-#define MAP_MAX 100
+#define MAP_MAX 65536   // 每边最多的格子数
+
+// 每个格子 2 位，一个 64 位字存 32 个格子，每行从新的字开始；大小在运行时决定。
+// 起点和终点另外记在一张小表里，不用扫描整张地图就能找到。
+// blocks[i][j] 通过代理对象读写，写法和原来的 GLint 数组一样。
+// 另外按行维护一张墙的位图（每位一个格子），邻居和连通性查询可以一次处理 64 个格子，见 bitboard.h。
+// 格子默认按行存放；也可以换成 8x8 的块，块内按 Z 序（Morton）排列，一个块正好两个字，
+// 上下相邻的格子大多落在同一个缓存行里。
+// 格子和墙位图的内存可以直接是映射进来的地图文件（见 mapfile.h），不用解析也不用拷贝。
+#define MAP_CELL_BITS 2
+#define MAP_CELLS_PER_WORD 32
+#define MAP_CELL_MASK 3ull
+#define MAP_TILE_SIZE 8
+#define MAP_TILE_CELLS 64
+
+// 把 3 位数的各位分开放到偶数位上：abc -> a0b0c
+static const unsigned char MAP_MORTON_SPREAD[8] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+
+// 取出偶数位上的 32 位，紧凑地放到低 32 位
+inline uint64_t mapCompactEvenBits(uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+    return (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+}
+
+// mapCompactEvenBits 的逆运算：低 32 位分开放到偶数位上
+inline uint64_t mapSpreadEvenBits(uint64_t x) {
+    x &= 0x00000000FFFFFFFFull;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    return (x | (x << 1)) & 0x5555555555555555ull;
+}
+
+struct MapMarker {
+    GLint i, j;
+    GLint type;     // MAP_BLOCK_START 或 MAP_BLOCK_END
+};
+
+struct MapBlocks;
+
+struct MapCellRef {
+    MapBlocks* blocks;
+    size_t i, j;
+    inline operator GLint() const;
+    inline MapCellRef& operator=(GLint v);
+    MapCellRef& operator=(const MapCellRef& o) { return *this = (GLint)o; }
+};
+
+struct MapRow {
+    MapBlocks* blocks;
+    size_t i;
+    MapCellRef operator[](size_t j) const { return MapCellRef{ blocks, i, j }; }
+};
+
+struct MapConstRow {
+    const MapBlocks* blocks;
+    size_t i;
+    inline GLint operator[](size_t j) const;
+};
+
+// 一段 u64 数组：平时自己持有内存；也可以借用别人的内存（例如 mmap 进来的文件），
+// 由 backing 保证在最后一个借用者释放之前不会被回收。
+// 复制时总是拷贝成自己持有的内存，所以复制出来的地图可以随便改。
+struct MapWords {
+    std::vector<uint64_t> owned;
+    uint64_t* ptr = nullptr;
+    size_t count = 0;
+    std::shared_ptr<void> backing;
+
+    MapWords() {}
+    MapWords(const MapWords& o) : owned(o.ptr, o.ptr + o.count), ptr(owned.data()), count(o.count) {}
+    MapWords(MapWords&& o) noexcept { *this = std::move(o); }
+    MapWords& operator=(const MapWords& o) {
+        if (this != &o) *this = MapWords(o);
+        return *this;
+    }
+    MapWords& operator=(MapWords&& o) noexcept {
+        owned = std::move(o.owned);     // vector 移动之后缓冲区地址不变，ptr 仍然有效
+        ptr = o.ptr;
+        count = o.count;
+        backing = std::move(o.backing);
+        o.ptr = nullptr;
+        o.count = 0;
+        return *this;
+    }
+
+    void assign(size_t n, uint64_t v) {
+        backing.reset();
+        owned.assign(n, v);
+        owned.shrink_to_fit();
+        ptr = owned.data();
+        count = n;
+    }
+    void borrow(uint64_t* p, size_t n, std::shared_ptr<void> b) {
+        owned = std::vector<uint64_t>();
+        ptr = p;
+        count = n;
+        backing = std::move(b);
+    }
+    bool borrowed() const { return backing != nullptr; }
+
+    uint64_t& operator[](size_t k) { return ptr[k]; }
+    const uint64_t& operator[](size_t k) const { return ptr[k]; }
+    uint64_t* data() { return ptr; }
+    const uint64_t* data() const { return ptr; }
+    size_t size() const { return count; }
+    uint64_t* begin() { return ptr; }
+    uint64_t* end() { return ptr + count; }
+};
+
+struct MapBlocks {
+    MapWords words;
+    size_t stride = 0;                  // 按行存放时每行的字数
+    bool tiled = false;
+    size_t tilesPerRow = 0;
+    std::vector<MapMarker> markers;
+    MapWords walls;                     // 第 j 位对应第 j 列，行尾多出来的位恒为 0
+    size_t wallStride = 0;
+
+    // 格子在 words 里的序号（以格子为单位）
+    size_t cellIndex(size_t i, size_t j) const {
+        if (!tiled) return i * stride * MAP_CELLS_PER_WORD + j;
+        size_t tile = (i / MAP_TILE_SIZE) * tilesPerRow + j / MAP_TILE_SIZE;
+        return tile * MAP_TILE_CELLS + (MAP_MORTON_SPREAD[i % MAP_TILE_SIZE] << 1 | MAP_MORTON_SPREAD[j % MAP_TILE_SIZE]);
+    }
+
+    GLint get(size_t i, size_t j) const {
+        size_t c = cellIndex(i, j);
+        return (GLint)((words[c / MAP_CELLS_PER_WORD] >> (c % MAP_CELLS_PER_WORD * MAP_CELL_BITS)) & MAP_CELL_MASK);
+    }
+
+    void set(size_t i, size_t j, GLint v) {
+        GLint old = get(i, j);
+        if (old == v) return;
+        size_t c = cellIndex(i, j);
+        uint64_t& w = words[c / MAP_CELLS_PER_WORD];
+        unsigned shift = c % MAP_CELLS_PER_WORD * MAP_CELL_BITS;
+        w = (w & ~(MAP_CELL_MASK << shift)) | ((uint64_t)(v & MAP_CELL_MASK) << shift);
+        uint64_t& wall = walls[i * wallStride + j / 64];
+        if (v == MAP_BLOCK_CUBE) wall |= 1ull << (j % 64);
+        else wall &= ~(1ull << (j % 64));
+        if (old == MAP_BLOCK_START || old == MAP_BLOCK_END) {
+            for (size_t k = 0; k < markers.size(); k++) {
+                if (markers[k].i == (GLint)i && markers[k].j == (GLint)j) {
+                    markers.erase(markers.begin() + k);
+                    break;
+                }
+            }
+        }
+        if (v == MAP_BLOCK_START || v == MAP_BLOCK_END)
+            markers.push_back(MapMarker{ (GLint)i, (GLint)j, v });
+    }
+
+    bool isWall(size_t i, size_t j) const { return (walls[i * wallStride + j / 64] >> (j % 64)) & 1; }
+    const uint64_t* wallRow(size_t i) const { return walls.data() + i * wallStride; }
+
+    MapRow operator[](size_t i) { return MapRow{ this, i }; }
+    MapConstRow operator[](size_t i) const { return MapConstRow{ this, i }; }
+};
+
+MapCellRef::operator GLint() const { return blocks->get(i, j); }
+MapCellRef& MapCellRef::operator=(GLint v) { blocks->set(i, j, v); return *this; }
+GLint MapConstRow::operator[](size_t j) const { return blocks->get(i, j); }
 
 struct Map {
-    GLint width;
-    GLint height;
-    GLint blocks[MAP_MAX][MAP_MAX];
+    GLint width = 0;
+    GLint height = 0;
+    MapBlocks blocks;
+
+    // 重新分配并清空；超出 MAP_MAX 返回 false，地图保持不变
+    bool resize(GLint w, GLint h) {
+        if (w <= 0 || h <= 0 || w > MAP_MAX || h > MAP_MAX) return false;
+        blocks.words.assign(setShape(w, h), 0);
+        blocks.walls.assign(blocks.wallStride * h, 0);
+        blocks.markers.clear();
+        return true;
+    }
+
+    // 只设置尺寸和步长，不分配内存；返回格子需要的字数（墙位图是 wallStride * h 个字）
+    size_t setShape(GLint w, GLint h) {
+        width = w;
+        height = h;
+        blocks.stride = ((size_t)w + MAP_CELLS_PER_WORD - 1) / MAP_CELLS_PER_WORD;
+        blocks.tilesPerRow = ((size_t)w + MAP_TILE_SIZE - 1) / MAP_TILE_SIZE;
+        blocks.wallStride = ((size_t)w + 63) / 64;
+        if (!blocks.tiled) return blocks.stride * h;
+        size_t tileRows = ((size_t)h + MAP_TILE_SIZE - 1) / MAP_TILE_SIZE;
+        return blocks.tilesPerRow * tileRows * (MAP_TILE_CELLS / MAP_CELLS_PER_WORD);
+    }
+
+    // 切换格子的存放方式，内容不变
+    void setTiled(bool on) {
+        if (blocks.tiled == on) return;
+        Map old = *this;
+        blocks.tiled = on;
+        resize(width, height);
+        for (GLint i = 0; i < height; i++)
+            for (GLint j = 0; j < width; j++)
+                blocks.set(i, j, old.blocks.get(i, j));
+    }
+
+    // 整张地图填成空地或墙（起点和终点要逐个设置）
+    void fill(GLint v) {
+        uint64_t pattern = 0;
+        for (int k = 0; k < MAP_CELLS_PER_WORD; k++) pattern |= (uint64_t)(v & MAP_CELL_MASK) << (k * MAP_CELL_BITS);
+        std::fill(blocks.words.begin(), blocks.words.end(), pattern);
+        std::fill(blocks.walls.begin(), blocks.walls.end(), v == MAP_BLOCK_CUBE ? ~0ull : 0ull);
+        if (v == MAP_BLOCK_CUBE && width % 64) {
+            for (GLint i = 0; i < height; i++)
+                blocks.walls[(i + 1) * blocks.wallStride - 1] = (1ull << (width % 64)) - 1;
+        }
+        blocks.markers.clear();
+    }
+
+    // 直接写过 blocks.words 之后调用：根据格子重建墙位图和起点/终点表
+    void rebuildIndex() {
+        std::fill(blocks.walls.begin(), blocks.walls.end(), 0ull);
+        blocks.markers.clear();
+        if (blocks.tiled) {
+            for (GLint i = 0; i < height; i++) {
+                for (GLint j = 0; j < width; j++) {
+                    GLint v = blocks.get(i, j);
+                    if (v == MAP_BLOCK_CUBE) blocks.walls[i * blocks.wallStride + j / 64] |= 1ull << (j % 64);
+                    else if (v != MAP_BLOCK_EMPTY) blocks.markers.push_back(MapMarker{ i, j, v });
+                }
+            }
+            return;
+        }
+        // 按行存放时一次处理一个字：低位为 1、高位为 0 的格子是墙，高位为 1 的是起点或终点
+        const uint64_t even = 0x5555555555555555ull;
+        for (GLint i = 0; i < height; i++) {
+            const uint64_t* row = &blocks.words[i * blocks.stride];
+            uint64_t* walls = &blocks.walls[i * blocks.wallStride];
+            for (size_t k = 0; k < blocks.stride; k++) {
+                uint64_t lo = row[k] & even, hi = (row[k] >> 1) & even;
+                size_t j0 = k * MAP_CELLS_PER_WORD;
+                size_t valid = std::min((size_t)MAP_CELLS_PER_WORD, (size_t)width - j0);
+                uint64_t mask = valid == MAP_CELLS_PER_WORD ? ~0ull : (1ull << (valid * 2)) - 1;
+                walls[k / 2] |= mapCompactEvenBits(lo & ~hi & mask) << (k % 2 * 32);
+                if (!(hi & mask)) continue;
+                for (size_t c = 0; c < valid; c++) {
+                    if ((hi >> (c * 2)) & 1)
+                        blocks.markers.push_back(MapMarker{ i, (GLint)(j0 + c), blocks.get(i, j0 + c) });
+                }
+            }
+        }
+    }
+
+    // 第一个指定类型的标记；没有返回 false
+    bool findMarker(GLint type, GLint& i, GLint& j) const {
+        for (size_t k = 0; k < blocks.markers.size(); k++) {
+            if (blocks.markers[k].type != type) continue;
+            i = blocks.markers[k].i;
+            j = blocks.markers[k].j;
+            return true;
+        }
+        return false;
+    }
 };
 
 const GLint MAP2_WIDTH = 10;
@@ -50,6 +312,23 @@ struct Player {
 #define MAP_BLOCK_LENGTH 40
 #define PLAYER_CUBE_SIZE (MAP_BLOCK_LENGTH / 2.4f)
 
+#define MAZE_CHUNK_SIZE 8
+
+#define LOD_NEAR 0
+#define LOD_MID  1
+#define LOD_FAR  2
+#define LOD_NEAR_DISTANCE 12    // 以格子为单位
+#define LOD_MID_DISTANCE  32
+#define LOD_HYSTERESIS    2
+
+#define CHUNK_QUERY_NONE     0
+#define CHUNK_QUERY_GEOMETRY 1
+#define CHUNK_QUERY_BOUNDS   2
+
+#define IMPOSTOR_TEXELS_PER_CELL 32
+#define IMPOSTOR_MAX_SIZE 4096
+#define IMPOSTOR_DEPTH_RADIUS 2   // 玩家周围这么多格以内的墙补写深度
+
 typedef GLint ViewMode;
 #define VIEW_MODE_FRIST_PERSON 1
 #define VIEW_MODE_THIRD_PERSON 2
@@ -6,11 +6,23 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "define.h"
+#include "recorder.h"
+#include "profiler.h"
+#include "trace.h"
+#include "renderstats.h"
+#include "perfcounters.h"
+#include "replay.h"
+#include "mazegen.h"
+#include "bitboard.h"
+#include "mapfile.h"
+#include "mapstream.h"
 
 #include <cstdio>
 #include <cmath>
 #include <chrono>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 // ---------------- globals ----------------
 Color white, gray, green;
@@ -40,6 +52,89 @@ const float COMPLETE_FADE_SPEED = 1.5f;
 // 键盘状态（用于平滑控制）
 bool keyUp = false, keyLeft = false, keyRight = false;
 
+// 录像
+FrameRecorder recorder;
+const char* recordPath = "maze.y4m";
+GLuint recordPBO[2] = {0, 0};
+unsigned recordPBORepeat[2] = {0, 0};
+int recordPBOIndex = 0;
+double recordNextTime = 0;
+
+// 输入回放日志
+ReplayWriter inputLog;
+bool replaying = false;
+
+// 时间线追踪
+const char* tracePath = "maze_trace.json";
+
+// HUD 上的渲染统计
+bool showRenderStats = false;
+
+// 墙体由近到远绘制（关闭后退回逐行顺序，便于对比）
+bool frontToBack = true;
+
+// 无窗口模式下用遮挡查询统计迷宫的过度绘制
+bool countOverdraw = false;
+GLuint overdrawQuery = 0;
+GLuint lastMazeSamples = 0;
+
+// 全局视角的俯视贴图缓存
+bool useImpostor = true;
+bool impostorDirty = true;
+Texture impostorTex = {0,0,0};
+
+// 分块与距离 LOD
+bool lodEnabled = true;
+int chunksX = 0, chunksY = 0;
+std::vector<int> chunkWalls;
+std::vector<unsigned char> chunkLod;
+int lodCells[3] = {0, 0, 0};    // 本帧各层级画了多少个墙格
+
+// 分块遮挡查询
+bool occlusionEnabled = true;
+std::vector<GLuint> chunkQuery;
+std::vector<unsigned char> chunkQueryState;
+std::vector<unsigned char> chunkOccluded;
+GLuint chunkSamples = 0;
+int chunksDrawn = 0, chunksOccluded = 0;
+
+// 流式地图：mapData 只是玩家周围 STREAM_WINDOW x STREAM_WINDOW 块的窗口，玩家走远时整体平移
+MapStream mapStream;
+bool streaming = false;
+int streamOriginY = 0, streamOriginX = 0;   // 窗口左上角在整张地图里是第几块
+std::vector<int> streamShown;               // 窗口里每块现在显示的块号，-1 是占位的墙，-2 还没写过
+unsigned streamLoadsSeen = 0;
+
+// 无尽模式（--endless）：mapData 是固定高度的窗口，前方的行由 Eller 算法一排一排生成，身后的行丢掉
+#define ENDLESS_WINDOW_ROWS 256
+#define ENDLESS_AHEAD_ROWS  128     // 玩家前方不到这么多行时窗口前移
+#define ENDLESS_SHIFT_ROWS  64      // 每次前移的行数，是分块大小的整数倍，分块的划分不变
+bool endless = false;
+MazeEller endlessGen;
+std::vector<uint8_t> endlessOpen;   // 最近生成的一排房间
+long long endlessDropped = 0;       // 已经丢掉的行数
+
+// 无限迷宫（--infinite）：和流式地图一样，mapData 是玩家周围 STREAM_WINDOW x STREAM_WINDOW 块的窗口，
+// 但块不从文件读，而是在进入窗口时由 (种子, 块坐标) 现生成，离开窗口就丢掉。地图不能修改，所以什么都不用存
+bool infinite = false;
+uint64_t infiniteSeed = 1;
+long long infiniteOriginY = 0, infiniteOriginX = 0;     // 窗口左上角的块坐标，可以是负数
+static_assert(STREAM_CHUNK == MAZE_CHUNK_CELLS, "infinite chunks share the stream window layout");
+
+// --gen：没有给地图文件时由 initGame() 生成迷宫，代替内置地图
+int genAlgorithm = -1;
+int genWidth = 41, genHeight = 41;
+uint64_t genSeed = 1;
+int genThreads = -1;                // >= 0 时分区并行生成，0 是全部硬件线程
+
+// 加载时的分析：自动模式下跳过映射进来的地图和超过 4096x4096 的地图
+#define MAP_ANALYSIS_MAX_CELLS (4096LL * 4096)
+#define MAP_ANALYSIS_MAX_MAPPED_CELLS (1024LL * 1024)   // 映射进来的地图分析时要把整个文件读一遍，门槛更低
+#define MAP_ANALYSIS_OFF  -1
+#define MAP_ANALYSIS_AUTO 0
+#define MAP_ANALYSIS_ON   1
+int mapAnalysisMode = MAP_ANALYSIS_AUTO;
+
 // ---------------- time ----------------
 double now() {
     using namespace std::chrono;
@@ -48,8 +143,13 @@ double now() {
 
 // ---------------- load texture ----------------
 bool loadTexture(Texture& tex, const char* file) {
+    TRACE_SCOPE("loadTexture");
     int ch;
-    unsigned char* data = stbi_load(file, &tex.width, &tex.height, &ch, 3);
+    unsigned char* data;
+    {
+        PERF_ZONE("decodeTexture");
+        data = stbi_load(file, &tex.width, &tex.height, &ch, 3);
+    }
     if (!data) {
         printf("Texture not found: %s\n", file);
         return false;
@@ -68,9 +168,59 @@ bool loadTexture(Texture& tex, const char* file) {
 
 // ---------------- map utilities ----------------
 bool canMove(int tx, int ty) {
+    PERF_ZONE("canMove");
     if (tx < 0 || ty < 0 || tx >= mapData.height || ty >= mapData.width)
         return false;
-    return mapData.blocks[tx][ty] != MAP_BLOCK_CUBE;
+    return !mapData.blocks.isWall(tx, ty);
+}
+
+// 地图按 MAZE_CHUNK_SIZE 分块，每块记录墙的数量和当前的 LOD 层级
+void rebuildChunks() {
+    PERF_ZONE("mapScan");
+    chunksX = (mapData.width + MAZE_CHUNK_SIZE - 1) / MAZE_CHUNK_SIZE;
+    chunksY = (mapData.height + MAZE_CHUNK_SIZE - 1) / MAZE_CHUNK_SIZE;
+    chunkWalls.assign(chunksX * chunksY, 0);
+    chunkLod.assign(chunksX * chunksY, LOD_NEAR);
+    // 墙位图里每 MAZE_CHUNK_SIZE 位正好是一个分块的一行
+    static_assert(64 % MAZE_CHUNK_SIZE == 0, "chunk rows must not straddle bitboard words");
+    const uint64_t chunkMask = (1ull << MAZE_CHUNK_SIZE) - 1;
+    for (int i = 0; i < mapData.height; i++) {
+        const uint64_t* row = mapData.blocks.wallRow(i);
+        int* counts = &chunkWalls[(i / MAZE_CHUNK_SIZE) * chunksX];
+        for (int cx = 0; cx < chunksX; cx++) {
+            int bit = cx * MAZE_CHUNK_SIZE;
+            counts[cx] += bitCount((row[bit / 64] >> (bit % 64)) & chunkMask);
+        }
+    }
+}
+
+// 地图内容变了，上一帧的遮挡结果不能沿用：丢掉还没读的查询，所有分块先当作可见
+void resetChunkOcclusion() {
+    std::fill(chunkQueryState.begin(), chunkQueryState.end(), CHUNK_QUERY_NONE);
+    std::fill(chunkOccluded.begin(), chunkOccluded.end(), 0);
+}
+
+// 从 (si, sj) 到 (ei, ej) 的最短步数（广度优先），走不到返回 -1
+int shortestPathLength(int si, int sj, int ei, int ej) {
+    if (!canMove(si, sj)) return -1;
+    size_t w = (size_t)mapData.width;
+    std::vector<int> dist(w * mapData.height, -1);
+    std::vector<size_t> queue;
+    dist[si * w + sj] = 0;
+    queue.push_back(si * w + sj);
+    static const int DI[4] = { -1, 1, 0, 0 }, DJ[4] = { 0, 0, -1, 1 };
+    for (size_t head = 0; head < queue.size(); head++) {
+        size_t cur = queue[head];
+        int i = (int)(cur / w), j = (int)(cur % w);
+        if (i == ei && j == ej) return dist[cur];
+        for (int d = 0; d < 4; d++) {
+            int ni = i + DI[d], nj = j + DJ[d];
+            if (!canMove(ni, nj) || dist[ni * w + nj] >= 0) continue;
+            dist[ni * w + nj] = dist[cur] + 1;
+            queue.push_back(ni * w + nj);
+        }
+    }
+    return -1;
 }
 
 // ---------------- 根据角度更新玩家朝向 ----------------
@@ -157,33 +307,15 @@ void getForwardTarget(int& tx, int& ty) {
     }
 }
 
-// ---------------- init ----------------
-void initGame() {
-    white = {1,1,1};
-    gray = {0.15f,0.18f,0.2f};
-    green = {0.2f, 1.0f, 0.3f};
-
-    mapData.width = MAP2_WIDTH;
-    mapData.height = MAP2_HEIGHT;
-    for (int i = 0; i < MAP2_WIDTH; i++)
-        for (int j = 0; j < MAP2_HEIGHT; j++)
-            mapData.blocks[i][j] = MAP2_BLOCKS[i][j];
+// ---------------- 换地图 ----------------
+// mapData 换成新内容之后调用：重建分块，玩家回到起点，清掉移动和完成状态
+void resetMap() {
+    rebuildChunks();
+    resetChunkOcclusion();
+    impostorDirty = true;
 
-    // 找到起始位置
-    bool foundStart = false;
-    for (int i = 0; i < mapData.height; i++) {
-        for (int j = 0; j < mapData.width; j++) {
-            if (mapData.blocks[i][j] == MAP_BLOCK_START) {
-                player.x = i;
-                player.y = j;
-                foundStart = true;
-                break;
-            }
-        }
-        if (foundStart) break;
-    }
-    
-    if (!foundStart) {
+    // 起点记在地图的标记表里
+    if (!mapData.findMarker(MAP_BLOCK_START, player.x, player.y)) {
         printf("Warning: No start position found! Using default (0,0)\n");
         player.x = player.y = 0;
     }
@@ -191,17 +323,307 @@ void initGame() {
     // 初始方向为向上
     player.face = PLAYER_FACE_UP;
     playerAngle = 0.0f;
-
-    // 加载纹理
-    loadTexture(wallTex, "wall.jpg");
-    loadTexture(completeTex, "complete.jpg");
+    moving = false;
+    t_move = 0.0f;
+    gameCompleted = false;
+    completeAlpha = 0.0f;
 
     // 初始世界坐标
     px_src = px_dst = player.y * MAP_BLOCK_LENGTH + MAP_BLOCK_LENGTH / 2.0f;
     py_src = py_dst = mapData.height * MAP_BLOCK_LENGTH - player.x * MAP_BLOCK_LENGTH - MAP_BLOCK_LENGTH / 2.0f;
+    updateCameras(px_src, py_src);
+}
+
+// 每次加载都跑一遍：终点走不到时给出警告。
+// 分析要分配和地图一样大的位图并走遍所有空地，很大的地图默认跳过；映射进来的地图走一遍会把整个
+// 文件读进来，抵消了映射省下的启动时间，所以门槛更低。--analysis 强制分析
+void reportMapAnalysis() {
+    if (mapAnalysisMode == MAP_ANALYSIS_OFF) return;
+    bool mapped = mapData.blocks.words.borrowed();
+    long long limit = mapped ? MAP_ANALYSIS_MAX_MAPPED_CELLS : MAP_ANALYSIS_MAX_CELLS;
+    if (mapAnalysisMode == MAP_ANALYSIS_AUTO && (long long)mapData.width * mapData.height > limit) {
+        printf("Map analysis skipped for a large %s%dx%d map (--analysis forces it)\n",
+               mapped ? "mapped " : "", mapData.width, mapData.height);
+        return;
+    }
+    double t0 = now();
+    MapAnalysis a = mapAnalyze(mapData);
+    printf("Map analysis in %.3f ms: %lld open cells in %lld component(s), %lld reachable from start, "
+           "%lld dead ends, %lld junctions\n", (now() - t0) * 1000.0, a.open, a.components, a.reachable,
+           a.deadEnds, a.junctions);
+    if (!a.hasEnd) printf("Warning: No end position found!\n");
+    else if (a.pathLength < 0) printf("Warning: End position is not reachable from start!\n");
+    else printf("Shortest path to end: %d steps\n", a.pathLength);
+}
+
+// ---------------- 窗口平移 ----------------
+// 流式、无尽和无限地图里 mapData 只是一个窗口。窗口的内容已经换成新位置之后调用：
+// 窗口往下移了 di 行、往右移了 dj 列，oldHeight 是换之前的窗口高度。
+// 玩家的格子坐标和世界坐标跟着平移，画面上看不出来；分块、遮挡结果和俯视贴图重建
+void shiftWindow(int di, int dj, int oldHeight) {
+    player.x -= di;
+    player.y -= dj;
+    // drawMazeCell 里 y = (height - i - 1) * 边长
+    float dx = -dj * (float)MAP_BLOCK_LENGTH, dy = (mapData.height - oldHeight + di) * (float)MAP_BLOCK_LENGTH;
+    px_src += dx; px_dst += dx;
+    py_src += dy; py_dst += dy;
+    resetChunkOcclusion();
+    rebuildChunks();
+    impostorDirty = true;
+}
+
+// ---------------- 流式地图 ----------------
+// 窗口的大小随位置变化（靠近地图边缘时变小），左上角总是对齐到块
+void streamResizeWindow() {
+    int h = std::min(STREAM_WINDOW * STREAM_CHUNK, mapStream.height - streamOriginY * STREAM_CHUNK);
+    int w = std::min(STREAM_WINDOW * STREAM_CHUNK, mapStream.width - streamOriginX * STREAM_CHUNK);
+    mapData.resize(w, h);
+    streamShown.assign(STREAM_WINDOW * STREAM_WINDOW, -2);
+}
+
+// 把已经到达的块拷进窗口，没到的块填成墙：玩家走不进去，canMove() 也不用等。
+// 窗口和块都按字对齐，每行直接拷贝整字。
+void streamSyncWindow() {
+    PERF_ZONE("streamSync");
+    MapBlocks& b = mapData.blocks;
+    bool changed = false;
+    for (int a = 0; a * STREAM_CHUNK < mapData.height; a++) {
+        for (int c = 0; c * STREAM_CHUNK < mapData.width; c++) {
+            const StreamSlot* slot = mapStreamChunk(mapStream, streamOriginY + a, streamOriginX + c);
+            int id = (streamOriginY + a) * mapStream.chunksX + streamOriginX + c;
+            int shown = slot ? id : -1;
+            int& cur = streamShown[a * STREAM_WINDOW + c];
+            // 已经拷进窗口的块，槽被换掉之后窗口里的内容仍然是对的，不要再填成墙
+            if (cur == shown || (!slot && cur == id)) continue;
+            cur = shown;
+            changed = true;
+            int rows = std::min(STREAM_CHUNK, mapData.height - a * STREAM_CHUNK);
+            int cols = std::min(STREAM_CHUNK, mapData.width - c * STREAM_CHUNK);
+            uint64_t wallMask = cols == 64 ? ~0ull : (1ull << cols) - 1;
+            for (int r = 0; r < rows; r++) {
+                size_t i = (size_t)a * STREAM_CHUNK + r;
+                for (int w = 0; w < STREAM_CHUNK_WORDS; w++) {
+                    size_t k = (size_t)c * STREAM_CHUNK_WORDS + w;
+                    if (k >= b.stride) break;
+                    int valid = std::min(MAP_CELLS_PER_WORD, cols - w * MAP_CELLS_PER_WORD);
+                    uint64_t cellMask = valid == MAP_CELLS_PER_WORD ? ~0ull : (1ull << (valid * MAP_CELL_BITS)) - 1;
+                    b.words[i * b.stride + k] = slot ? slot->cells[r * STREAM_CHUNK_WORDS + w]
+                                                     : 0x5555555555555555ull & cellMask;
+                }
+                b.walls[i * b.wallStride + c] = slot ? slot->walls[r] : wallMask;
+            }
+        }
+    }
+    if (!changed) return;
+
+    // 起点和终点只放进已经到达的块
+    b.markers.clear();
+    for (size_t k = 0; k < mapStream.markers.size(); k++) {
+        MapMarker m = mapStream.markers[k];
+        m.i -= streamOriginY * STREAM_CHUNK;
+        m.j -= streamOriginX * STREAM_CHUNK;
+        if (m.i < 0 || m.j < 0 || m.i >= mapData.height || m.j >= mapData.width) continue;
+        if (streamShown[(m.i / STREAM_CHUNK) * STREAM_WINDOW + m.j / STREAM_CHUNK] >= 0) b.markers.push_back(m);
+    }
+    rebuildChunks();
+    impostorDirty = true;
+}
+
+// 玩家所在的块离开窗口中心时平移窗口，玩家的格子坐标和世界坐标跟着平移，画面上看不出来
+bool streamRecenter() {
+    int gi = streamOriginY * STREAM_CHUNK + player.x, gj = streamOriginX * STREAM_CHUNK + player.y;
+    int oy = std::max(0, std::min(gi / STREAM_CHUNK - STREAM_RADIUS, mapStream.chunksY - STREAM_WINDOW));
+    int ox = std::max(0, std::min(gj / STREAM_CHUNK - STREAM_RADIUS, mapStream.chunksX - STREAM_WINDOW));
+    if (oy == streamOriginY && ox == streamOriginX) return false;
+    int di = (oy - streamOriginY) * STREAM_CHUNK, dj = (ox - streamOriginX) * STREAM_CHUNK;
+    int oldHeight = mapData.height;
+    streamOriginY = oy;
+    streamOriginX = ox;
+    streamResizeWindow();
+    shiftWindow(di, dj, oldHeight);
+    return true;
+}
+
+// 每一步调用一次：必要时平移窗口，重新排读盘请求，把新到的块拷进窗口
+void streamTick() {
+    bool moved = streamRecenter();
+    mapStreamUpdate(mapStream, streamOriginY, streamOriginX, streamOriginY * STREAM_CHUNK + player.x,
+                    streamOriginX * STREAM_CHUNK + player.y, player.face);
+    unsigned loads = mapStream.loads.load(std::memory_order_acquire);
+    if (moved || loads != streamLoadsSeen) {
+        streamLoadsSeen = loads;
+        streamSyncWindow();
+    }
+}
+
+// 在 initGame() 之前调用：窗口放在起点周围，只等起点所在的那一块读进来
+bool startStreaming(const char* path, int budgetMB) {
+    if (!mapStreamOpen(mapStream, path, budgetMB)) return false;
+    int si = 0, sj = 0;
+    for (size_t k = 0; k < mapStream.markers.size(); k++) {
+        if (mapStream.markers[k].type != MAP_BLOCK_START) continue;
+        si = mapStream.markers[k].i;
+        sj = mapStream.markers[k].j;
+        break;
+    }
+    streaming = true;
+    mapData.blocks.tiled = false;
+    streamOriginY = std::max(0, std::min(si / STREAM_CHUNK - STREAM_RADIUS, mapStream.chunksY - STREAM_WINDOW));
+    streamOriginX = std::max(0, std::min(sj / STREAM_CHUNK - STREAM_RADIUS, mapStream.chunksX - STREAM_WINDOW));
+    streamResizeWindow();
+    mapStreamUpdate(mapStream, streamOriginY, streamOriginX, si, sj, PLAYER_FACE_UP);
+    if (!mapStreamWait(mapStream, si / STREAM_CHUNK, sj / STREAM_CHUNK, 10000))
+        printf("Stream: start chunk did not arrive\n");
+    streamLoadsSeen = mapStream.loads.load(std::memory_order_acquire);
+    streamSyncWindow();
+    return true;
+}
+
+// ---------------- 无尽迷宫 ----------------
+// 从窗口的第 bottom 行往上（往前）填 n 行：每排房间占一行，它和下一排之间的连接行在它上面一行
+void endlessFill(int bottom, int n) {
+    std::vector<uint64_t> row(mapData.blocks.wallStride);
+    for (int k = 0; k + 1 < n; k += 2) {
+        endlessGen.next(endlessOpen.data());
+        mazeRowWalls(row.data(), row.size(), mapData.width, endlessOpen.data(), endlessGen.cols, true);
+        mazeStoreRow(mapData, bottom - k, row.data());
+        mazeRowWalls(row.data(), row.size(), mapData.width, endlessOpen.data(), endlessGen.cols, false);
+        mazeStoreRow(mapData, bottom - k - 1, row.data());
+    }
+}
+
+// 每一步调用一次：玩家前方的行不够时窗口前移，整行平移格子和墙位图，再在前面补上新行。
+// 玩家的格子坐标和世界坐标跟着平移，画面上看不出来
+void endlessTick() {
+    if (player.x >= ENDLESS_AHEAD_ROWS) return;
+    PERF_ZONE("endlessAdvance");
+    const int s = ENDLESS_SHIFT_ROWS;
+    MapBlocks& b = mapData.blocks;
+    size_t keep = (size_t)(mapData.height - s);
+    memmove(&b.words[s * b.stride], &b.words[0], keep * b.stride * sizeof(uint64_t));
+    memmove(&b.walls[s * b.wallStride], &b.walls[0], keep * b.wallStride * sizeof(uint64_t));
+    std::vector<MapMarker> markers;
+    for (size_t k = 0; k < b.markers.size(); k++) {
+        MapMarker m = b.markers[k];
+        m.i += s;
+        if (m.i < mapData.height) markers.push_back(m);
+    }
+    b.markers.swap(markers);
+    endlessFill(s - 1, s);
+    endlessDropped += s;
+    shiftWindow(-s, 0, mapData.height);
+}
+
+// 在 initGame() 之前调用：起点在窗口最下面一排的最左边，朝前生成整个窗口
+bool startEndless(int width, uint64_t seed) {
+    int cols = (width - 1) / 2;
+    if (cols < 1 || width > MAP_MAX) {
+        printf("Endless maze width must be between 3 and %d\n", MAP_MAX);
+        return false;
+    }
+    endless = true;
+    mapData.blocks.tiled = false;
+    mapData.resize(width, ENDLESS_WINDOW_ROWS);
+    endlessGen.reset(cols, seed);
+    endlessOpen.assign(cols, 0);
+    endlessFill(ENDLESS_WINDOW_ROWS - 1, ENDLESS_WINDOW_ROWS);
+    mapData.blocks[ENDLESS_WINDOW_ROWS - 1][1] = MAP_BLOCK_START;
+    return true;
+}
+
+// ---------------- 无限迷宫 ----------------
+// 填满左上角为 (oy, ox) 的窗口：和旧窗口（old，左上角 (oldY, oldX)）重叠的块直接拷过来，其余的现生成。
+// 块和字都对齐，每块每行是两个格子字和一个墙位图字
+void infiniteFillWindow(const Map* old, long long oldY, long long oldX, long long oy, long long ox) {
+    PERF_ZONE("infiniteFill");
+    const int N = STREAM_WINDOW, C = STREAM_CHUNK;
+    Map window;
+    window.resize(N * C, N * C);
+    uint64_t walls[C];
+    for (int a = 0; a < N; a++) {
+        for (int c = 0; c < N; c++) {
+            long long sy = oy + a - oldY, sx = ox + c - oldX;
+            bool reuse = old && sy >= 0 && sx >= 0 && sy < N && sx < N;
+            if (!reuse) mazeChunkWalls(infiniteSeed, oy + a, ox + c, walls);
+            for (int r = 0; r < C; r++) {
+                size_t i = (size_t)a * C + r;
+                uint64_t* words = &window.blocks.words[i * window.blocks.stride + c * STREAM_CHUNK_WORDS];
+                if (reuse) {
+                    size_t si = (size_t)sy * C + r;
+                    memcpy(words, &old->blocks.words[si * old->blocks.stride + sx * STREAM_CHUNK_WORDS],
+                           STREAM_CHUNK_WORDS * sizeof(uint64_t));
+                    window.blocks.walls[i * window.blocks.wallStride + c] =
+                        old->blocks.walls[si * old->blocks.wallStride + sx];
+                    continue;
+                }
+                window.blocks.walls[i * window.blocks.wallStride + c] = walls[r];
+                for (int w = 0; w < STREAM_CHUNK_WORDS; w++) words[w] = mapSpreadEvenBits(walls[r] >> (w * 32));
+            }
+        }
+    }
+    // 起点在第 (0, 0) 块左上角的房间，窗口里有这一块时才放
+    long long si = -oy * C + 1, sj = -ox * C + 1;
+    if (si >= 0 && sj >= 0 && si < N * C && sj < N * C) window.blocks[si][sj] = MAP_BLOCK_START;
+    infiniteOriginY = oy;
+    infiniteOriginX = ox;
+    mapData = std::move(window);
+}
+
+// 每一步调用一次：玩家所在的块离开窗口中心时平移窗口，玩家的格子坐标和世界坐标跟着平移
+void infiniteTick() {
+    long long gi = infiniteOriginY * STREAM_CHUNK + player.x, gj = infiniteOriginX * STREAM_CHUNK + player.y;
+    long long oy = (gi >= 0 ? gi / STREAM_CHUNK : (gi + 1) / STREAM_CHUNK - 1) - STREAM_RADIUS;
+    long long ox = (gj >= 0 ? gj / STREAM_CHUNK : (gj + 1) / STREAM_CHUNK - 1) - STREAM_RADIUS;
+    if (oy == infiniteOriginY && ox == infiniteOriginX) return;
+    int di = (int)(oy - infiniteOriginY) * STREAM_CHUNK, dj = (int)(ox - infiniteOriginX) * STREAM_CHUNK;
+    Map old = std::move(mapData);
+    infiniteFillWindow(&old, infiniteOriginY, infiniteOriginX, oy, ox);
+    shiftWindow(di, dj, old.height);
+}
+
+// 在 initGame() 之前调用：窗口以第 (0, 0) 块为中心
+void startInfinite(uint64_t seed) {
+    infinite = true;
+    infiniteSeed = seed;
+    infiniteFillWindow(NULL, 0, 0, -STREAM_RADIUS, -STREAM_RADIUS);
+}
+
+// ---------------- init ----------------
+void initGame() {
+    TRACE_SCOPE("initGame");
+    white = {1,1,1};
+    gray = {0.15f,0.18f,0.2f};
+    green = {0.2f, 1.0f, 0.3f};
+
+    // 命令行没有给地图文件时生成迷宫，没有要求生成就使用内置地图
+    if (mapData.width == 0 && genAlgorithm >= 0) {
+        double t0 = now();
+        bool ok = genThreads >= 0
+                      ? generateMazeRegions(mapData, genWidth, genHeight, 1.0f, genSeed, genAlgorithm, genThreads)
+                      : generateMaze(mapData, genWidth, genHeight, 1.0f, genSeed, genAlgorithm);
+        if (ok)
+            printf("Maze generated (%s%s, %dx%d, seed %llu) in %.3f ms\n", MAZE_ALGO_NAMES[genAlgorithm],
+                   genThreads >= 0 ? ", regions" : "", genWidth, genHeight, (unsigned long long)genSeed,
+                   (now() - t0) * 1000.0);
+        else
+            printf("Cannot generate a %dx%d maze (need room for two rooms, at most %d per side)\n", genWidth, genHeight,
+                   MAP_MAX);
+    }
+    if (mapData.width == 0) {
+        mapData.resize(MAP2_WIDTH, MAP2_HEIGHT);
+        for (int i = 0; i < MAP2_WIDTH; i++)
+            for (int j = 0; j < MAP2_HEIGHT; j++)
+                mapData.blocks[i][j] = MAP2_BLOCKS[i][j];
+    }
+    resetMap();
+    // 流式、无尽和无限地图里只有窗口在内存中，分析不了整张图
+    if (!streaming && !endless && !infinite) reportMapAnalysis();
+
+    // 加载纹理
+    loadTexture(wallTex, "wall.jpg");
+    loadTexture(completeTex, "complete.jpg");
 
     lastTime = now();
-    updateCameras(px_src, py_src);
 
     // OpenGL 设置
     glEnable(GL_DEPTH_TEST);
@@ -235,96 +657,458 @@ void initGame() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     printf("Maze Game Loaded Successfully.\n");
-    printf("Controls: UP=Move Forward | LEFT/RIGHT=Turn | 1:F1 | 2:F2 | 3:F3 | ESC: quit\n");
+    printf("Controls: UP=Move Forward | LEFT/RIGHT=Turn | 1:F1 | 2:F2 | 3:F3 | I: impostor | L: LOD | O: occlusion | P: profiler | S: stats | T: trace | R: record | ESC: quit\n");
     printf("Find the red exit block (block type 3) to complete the maze!\n");
     printf("NOTE: You can only move forward, not backward.\n");
 }
 
 // ---------------- draw cube ----------------
-void drawCube(float x, float y, float z, float s, bool tex) {
+// faces 是 WALL_FACE_* 的组合，迷宫里的墙只画露在外面的面
+void drawCube(float x, float y, float z, float s, bool tex, int faces = WALL_FACE_ALL) {
     if (tex && wallTex.id) {
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, wallTex.id);
+        statEnable(GL_TEXTURE_2D);
+        statBindTexture(GL_TEXTURE_2D, wallTex.id);
     } else {
-        glDisable(GL_TEXTURE_2D);
+        statDisable(GL_TEXTURE_2D);
     }
 
     float x1 = x + s, y1 = y + s, z1 = z + s;
 
     // 顶部
-    glBegin(GL_QUADS);
-    glNormal3f(0, 0, 1);
-    glTexCoord2f(0,0); glVertex3f(x, y, z1);
-    glTexCoord2f(1,0); glVertex3f(x1, y, z1);
-    glTexCoord2f(1,1); glVertex3f(x1, y1, z1);
-    glTexCoord2f(0,1); glVertex3f(x, y1, z1);
-    glEnd();
+    if (faces & WALL_FACE_TOP) {
+        statBegin(GL_QUADS);
+        glNormal3f(0, 0, 1);
+        glTexCoord2f(0,0); statVertex3f(x, y, z1);
+        glTexCoord2f(1,0); statVertex3f(x1, y, z1);
+        glTexCoord2f(1,1); statVertex3f(x1, y1, z1);
+        glTexCoord2f(0,1); statVertex3f(x, y1, z1);
+        statEnd();
+    }
 
     // 底部
-    glBegin(GL_QUADS);
-    glNormal3f(0, 0, -1);
-    glTexCoord2f(0,0); glVertex3f(x, y, z);
-    glTexCoord2f(1,0); glVertex3f(x1, y, z);
-    glTexCoord2f(1,1); glVertex3f(x1, y1, z);
-    glTexCoord2f(0,1); glVertex3f(x, y1, z);
-    glEnd();
+    if (faces & WALL_FACE_BOTTOM) {
+        statBegin(GL_QUADS);
+        glNormal3f(0, 0, -1);
+        glTexCoord2f(0,0); statVertex3f(x, y, z);
+        glTexCoord2f(1,0); statVertex3f(x1, y, z);
+        glTexCoord2f(1,1); statVertex3f(x1, y1, z);
+        glTexCoord2f(0,1); statVertex3f(x, y1, z);
+        statEnd();
+    }
 
     // 前面
-    glBegin(GL_QUADS);
-    glNormal3f(0, -1, 0);
-    glTexCoord2f(0,0); glVertex3f(x, y, z);
-    glTexCoord2f(1,0); glVertex3f(x1, y, z);
-    glTexCoord2f(1,1); glVertex3f(x1, y, z1);
-    glTexCoord2f(0,1); glVertex3f(x, y, z1);
-    glEnd();
+    if (faces & WALL_FACE_SOUTH) {
+        statBegin(GL_QUADS);
+        glNormal3f(0, -1, 0);
+        glTexCoord2f(0,0); statVertex3f(x, y, z);
+        glTexCoord2f(1,0); statVertex3f(x1, y, z);
+        glTexCoord2f(1,1); statVertex3f(x1, y, z1);
+        glTexCoord2f(0,1); statVertex3f(x, y, z1);
+        statEnd();
+    }
 
     // 后面
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glTexCoord2f(0,0); glVertex3f(x, y1, z);
-    glTexCoord2f(1,0); glVertex3f(x1, y1, z);
-    glTexCoord2f(1,1); glVertex3f(x1, y1, z1);
-    glTexCoord2f(0,1); glVertex3f(x, y1, z1);
-    glEnd();
+    if (faces & WALL_FACE_NORTH) {
+        statBegin(GL_QUADS);
+        glNormal3f(0, 1, 0);
+        glTexCoord2f(0,0); statVertex3f(x, y1, z);
+        glTexCoord2f(1,0); statVertex3f(x1, y1, z);
+        glTexCoord2f(1,1); statVertex3f(x1, y1, z1);
+        glTexCoord2f(0,1); statVertex3f(x, y1, z1);
+        statEnd();
+    }
 
     // 左面
-    glBegin(GL_QUADS);
-    glNormal3f(-1, 0, 0);
-    glTexCoord2f(0,0); glVertex3f(x, y, z);
-    glTexCoord2f(1,0); glVertex3f(x, y1, z);
-    glTexCoord2f(1,1); glVertex3f(x, y1, z1);
-    glTexCoord2f(0,1); glVertex3f(x, y, z1);
-    glEnd();
+    if (faces & WALL_FACE_WEST) {
+        statBegin(GL_QUADS);
+        glNormal3f(-1, 0, 0);
+        glTexCoord2f(0,0); statVertex3f(x, y, z);
+        glTexCoord2f(1,0); statVertex3f(x, y1, z);
+        glTexCoord2f(1,1); statVertex3f(x, y1, z1);
+        glTexCoord2f(0,1); statVertex3f(x, y, z1);
+        statEnd();
+    }
 
     // 右面
-    glBegin(GL_QUADS);
-    glNormal3f(1, 0, 0);
-    glTexCoord2f(0,0); glVertex3f(x1, y, z);
-    glTexCoord2f(1,0); glVertex3f(x1, y1, z);
-    glTexCoord2f(1,1); glVertex3f(x1, y1, z1);
-    glTexCoord2f(0,1); glVertex3f(x1, y, z1);
-    glEnd();
+    if (faces & WALL_FACE_EAST) {
+        statBegin(GL_QUADS);
+        glNormal3f(1, 0, 0);
+        glTexCoord2f(0,0); statVertex3f(x1, y, z);
+        glTexCoord2f(1,0); statVertex3f(x1, y1, z);
+        glTexCoord2f(1,1); statVertex3f(x1, y1, z1);
+        glTexCoord2f(0,1); statVertex3f(x1, y, z1);
+        statEnd();
+    }
 
-    glDisable(GL_TEXTURE_2D);
+    statDisable(GL_TEXTURE_2D);
 }
 
 // ---------------- draw maze ----------------
-void drawMaze() {
-    for (int i = 0; i < mapData.height; i++) {
-        for (int j = 0; j < mapData.width; j++) {
-            float x = j * MAP_BLOCK_LENGTH;
-            float y = mapData.height * MAP_BLOCK_LENGTH - (i+1) * MAP_BLOCK_LENGTH;
-            
-            if (mapData.blocks[i][j] == MAP_BLOCK_CUBE) {
-                glColor3f(0.9, 0.9, 0.9);
-                drawCube(x, y, 0, MAP_BLOCK_LENGTH, true);
-            } else if (mapData.blocks[i][j] == MAP_BLOCK_END && !gameCompleted) {
-                // 绘制终点方块（红色）
-                glColor3f(1.0, 0.3, 0.3);
-                drawCube(x, y, 0, MAP_BLOCK_LENGTH, false);
+void drawMazeCell(int i, int j) {
+    float x = j * MAP_BLOCK_LENGTH;
+    float y = mapData.height * MAP_BLOCK_LENGTH - (i+1) * MAP_BLOCK_LENGTH;
+
+    if (mapData.blocks[i][j] == MAP_BLOCK_CUBE) {
+        glColor3f(0.9, 0.9, 0.9);
+        drawCube(x, y, 0, MAP_BLOCK_LENGTH, true, wallFaceMask(mapData, i, j));
+        statCells(1, 1);
+    } else if (mapData.blocks[i][j] == MAP_BLOCK_END && !gameCompleted) {
+        // 绘制终点方块（红色）
+        glColor3f(1.0, 0.3, 0.3);
+        drawCube(x, y, 0, MAP_BLOCK_LENGTH, false);
+        statCells(1, 1);
+    } else {
+        statCells(1, 0);
+    }
+}
+
+const Camare& activeCamera() {
+    if (viewMode == VIEW_MODE_FRIST_PERSON) return cam1P;
+    if (viewMode == VIEW_MODE_THIRD_PERSON) return cam3P;
+    return camGlobal;
+}
+
+// 世界坐标 -> 地图格子（与 drawMazeCell 的坐标换算相反），结果截断到地图范围内
+void worldToCell(float wx, float wy, int& i, int& j) {
+    i = mapData.height - 1 - (int)floor(wy / MAP_BLOCK_LENGTH);
+    j = (int)floor(wx / MAP_BLOCK_LENGTH);
+    if (i < 0) i = 0;
+    if (i >= mapData.height) i = mapData.height - 1;
+    if (j < 0) j = 0;
+    if (j >= mapData.width) j = mapData.width - 1;
+}
+
+// 以 (ci, cj) 为中心一圈一圈地访问 [i0,i1) x [j0,j1) 内的格子，越近越先访问
+template <typename F>
+void forEachRing(int ci, int cj, int i0, int j0, int i1, int j1, F visit) {
+    ci = std::min(std::max(ci, i0), i1 - 1);
+    cj = std::min(std::max(cj, j0), j1 - 1);
+    int maxR = std::max(std::max(ci - i0, i1 - 1 - ci), std::max(cj - j0, j1 - 1 - cj));
+    visit(ci, cj);
+    for (int r = 1; r <= maxR; r++) {
+        int ja = std::max(cj - r, j0), jb = std::min(cj + r, j1 - 1);
+        int ia = std::max(ci - r + 1, i0), ib = std::min(ci + r - 1, i1 - 1);
+        if (ci - r >= i0)
+            for (int j = ja; j <= jb; j++) visit(ci - r, j);
+        if (ci + r < i1)
+            for (int j = ja; j <= jb; j++) visit(ci + r, j);
+        if (cj - r >= j0)
+            for (int i = ia; i <= ib; i++) visit(i, cj - r);
+        if (cj + r < j1)
+            for (int i = ia; i <= ib; i++) visit(i, cj + r);
+    }
+}
+
+// ---------------- 分块与 LOD ----------------
+// 摄像机到分块包围盒的距离（世界坐标）
+float chunkDistance(const Camare& cam, int cy, int cx) {
+    int i0 = cy * MAZE_CHUNK_SIZE, i1 = std::min(i0 + MAZE_CHUNK_SIZE, mapData.height);
+    int j0 = cx * MAZE_CHUNK_SIZE, j1 = std::min(j0 + MAZE_CHUNK_SIZE, mapData.width);
+    float lo[3] = { (float)j0 * MAP_BLOCK_LENGTH, (float)(mapData.height - i1) * MAP_BLOCK_LENGTH, 0 };
+    float hi[3] = { (float)j1 * MAP_BLOCK_LENGTH, (float)(mapData.height - i0) * MAP_BLOCK_LENGTH, MAP_BLOCK_LENGTH };
+    float d2 = 0;
+    for (int k = 0; k < 3; k++) {
+        float p = cam.position[k];
+        float d = p < lo[k] ? lo[k] - p : (p > hi[k] ? p - hi[k] : 0);
+        d2 += d * d;
+    }
+    return sqrtf(d2);
+}
+
+// 带滞回的层级切换：变粗要越过阈值 + 滞回，变细要回到阈值 - 滞回以内，避免在边界上来回跳
+int updateChunkLod(int k, float dist) {
+    const float nearD = LOD_NEAR_DISTANCE * MAP_BLOCK_LENGTH;
+    const float midD = LOD_MID_DISTANCE * MAP_BLOCK_LENGTH;
+    const float h = LOD_HYSTERESIS * MAP_BLOCK_LENGTH;
+    int t = chunkLod[k];
+    if (t == LOD_NEAR && dist > nearD + h) t = LOD_MID;
+    if (t == LOD_MID && dist > midD + h) t = LOD_FAR;
+    if (t == LOD_FAR && dist < midD - h) t = LOD_MID;
+    if (t == LOD_MID && dist < nearD - h) t = LOD_NEAR;
+    chunkLod[k] = t;
+    return t;
+}
+
+// 不带纹理、不画底面的长方体
+void drawBox(float x0, float y0, float z0, float x1, float y1, float z1) {
+    statDisable(GL_TEXTURE_2D);
+    statBegin(GL_QUADS);
+    glNormal3f(0, 0, 1);
+    statVertex3f(x0, y0, z1); statVertex3f(x1, y0, z1); statVertex3f(x1, y1, z1); statVertex3f(x0, y1, z1);
+    glNormal3f(0, -1, 0);
+    statVertex3f(x0, y0, z0); statVertex3f(x1, y0, z0); statVertex3f(x1, y0, z1); statVertex3f(x0, y0, z1);
+    glNormal3f(0, 1, 0);
+    statVertex3f(x0, y1, z0); statVertex3f(x1, y1, z0); statVertex3f(x1, y1, z1); statVertex3f(x0, y1, z1);
+    glNormal3f(-1, 0, 0);
+    statVertex3f(x0, y0, z0); statVertex3f(x0, y1, z0); statVertex3f(x0, y1, z1); statVertex3f(x0, y0, z1);
+    glNormal3f(1, 0, 0);
+    statVertex3f(x1, y0, z0); statVertex3f(x1, y1, z0); statVertex3f(x1, y1, z1); statVertex3f(x1, y0, z1);
+    statEnd();
+}
+
+void drawChunk(int cy, int cx, int tier, int ci, int cj) {
+    int i0 = cy * MAZE_CHUNK_SIZE, i1 = std::min(i0 + MAZE_CHUNK_SIZE, mapData.height);
+    int j0 = cx * MAZE_CHUNK_SIZE, j1 = std::min(j0 + MAZE_CHUNK_SIZE, mapData.width);
+    float top = mapData.height * MAP_BLOCK_LENGTH;
+    int walls = chunkWalls[cy * chunksX + cx];
+
+    if (tier == LOD_NEAR) {
+        // 完整的带纹理立方体
+        if (frontToBack) {
+            forEachRing(ci, cj, i0, j0, i1, j1, drawMazeCell);
+        } else {
+            for (int i = i0; i < i1; i++)
+                for (int j = j0; j < j1; j++)
+                    drawMazeCell(i, j);
+        }
+    } else if (tier == LOD_MID) {
+        // 同一行里连续的墙合并成一个无纹理的长条
+        glColor3f(0.8, 0.8, 0.8);
+        statCells((i1 - i0) * (j1 - j0), 0);
+        for (int i = i0; i < i1; i++) {
+            float y = top - (i + 1) * MAP_BLOCK_LENGTH;
+            for (int j = j0; j < j1; ) {
+                int b = mapData.blocks[i][j];
+                if (b == MAP_BLOCK_END && !gameCompleted) {
+                    glColor3f(1.0, 0.3, 0.3);
+                    drawCube(j * MAP_BLOCK_LENGTH, y, 0, MAP_BLOCK_LENGTH, false);
+                    glColor3f(0.8, 0.8, 0.8);
+                    statCells(0, 1);
+                }
+                if (b != MAP_BLOCK_CUBE) { j++; continue; }
+                int e = j;
+                while (e < j1 && mapData.blocks[i][e] == MAP_BLOCK_CUBE) e++;
+                drawBox(j * MAP_BLOCK_LENGTH, y, 0, e * MAP_BLOCK_LENGTH, y + MAP_BLOCK_LENGTH, MAP_BLOCK_LENGTH);
+                statCells(0, e - j);
+                j = e;
+            }
+        }
+    } else {
+        if (walls > 0) {
+            // 整块画成一个盒子，颜色按墙的密度在地面色和墙色之间插值
+            float density = (float)walls / ((i1 - i0) * (j1 - j0));
+            glColor3f(gray.r + (0.7f - gray.r) * density,
+                      gray.g + (0.7f - gray.g) * density,
+                      gray.b + (0.7f - gray.b) * density);
+            drawBox(j0 * MAP_BLOCK_LENGTH, top - i1 * MAP_BLOCK_LENGTH, 0,
+                    j1 * MAP_BLOCK_LENGTH, top - i0 * MAP_BLOCK_LENGTH, MAP_BLOCK_LENGTH);
+            statCells((i1 - i0) * (j1 - j0), walls);
+        } else {
+            statCells((i1 - i0) * (j1 - j0), 0);
+        }
+        // 终点不逐格找，查标记表；盒子里的终点抬高一点，顶面露在盒子上面
+        if (!gameCompleted) {
+            float lift = walls > 0 ? MAP_BLOCK_LENGTH * 0.05f : 0.0f;
+            glColor3f(1.0, 0.3, 0.3);
+            for (size_t k = 0; k < mapData.blocks.markers.size(); k++) {
+                const MapMarker& mk = mapData.blocks.markers[k];
+                if (mk.type != MAP_BLOCK_END || mk.i < i0 || mk.i >= i1 || mk.j < j0 || mk.j >= j1) continue;
+                drawCube(mk.j * MAP_BLOCK_LENGTH, top - (mk.i + 1) * MAP_BLOCK_LENGTH, lift, MAP_BLOCK_LENGTH, false);
+                statCells(0, 1);
             }
         }
     }
+    lodCells[tier] += walls;
+}
+
+// ---------------- 分块遮挡查询 ----------------
+// 每个分块一个 GL_SAMPLES_PASSED 查询，结果在下一帧读取（不等待 GPU）。
+// 上一帧可见的分块照常绘制并统计；上一帧被完全挡住的分块只画包围盒（不写颜色和深度），
+// 包围盒一旦有片元通过深度测试，下一帧就恢复绘制。
+void prepareOcclusionQueries() {
+    size_t n = (size_t)chunksX * chunksY;
+    if (chunkQuery.size() == n) return;
+    if (!chunkQuery.empty()) glDeleteQueries((GLsizei)chunkQuery.size(), chunkQuery.data());
+    chunkQuery.assign(n, 0);
+    glGenQueries((GLsizei)n, chunkQuery.data());
+    chunkQueryState.assign(n, CHUNK_QUERY_NONE);
+    chunkOccluded.assign(n, 0);
+}
+
+// 读取上一帧发出的查询；结果还没回来就沿用旧的可见性
+void collectChunkQuery(int k, bool wait) {
+    if (chunkQueryState[k] == CHUNK_QUERY_NONE) return;
+    GLuint available = 1;
+    if (!wait) glGetQueryObjectuiv(chunkQuery[k], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+    GLuint samples;
+    glGetQueryObjectuiv(chunkQuery[k], GL_QUERY_RESULT, &samples);
+    chunkOccluded[k] = samples == 0;
+    if (chunkQueryState[k] == CHUNK_QUERY_GEOMETRY) chunkSamples += samples;
+    chunkQueryState[k] = CHUNK_QUERY_NONE;
+}
+
+// 过度绘制统计需要本帧的结果，这里同步等待所有查询（只在无窗口模式下使用）
+GLuint resolveChunkQueries() {
+    chunkSamples = 0;
+    for (size_t k = 0; k < chunkQueryState.size(); k++)
+        collectChunkQuery((int)k, true);
+    return chunkSamples;
+}
+
+void drawChunkBounds(int cy, int cx) {
+    int i0 = cy * MAZE_CHUNK_SIZE, i1 = std::min(i0 + MAZE_CHUNK_SIZE, mapData.height);
+    int j0 = cx * MAZE_CHUNK_SIZE, j1 = std::min(j0 + MAZE_CHUNK_SIZE, mapData.width);
+    float top = mapData.height * MAP_BLOCK_LENGTH;
+    statColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    statDepthMask(GL_FALSE);
+    drawBox(j0 * MAP_BLOCK_LENGTH, top - i1 * MAP_BLOCK_LENGTH, 0,
+            j1 * MAP_BLOCK_LENGTH, top - i0 * MAP_BLOCK_LENGTH, MAP_BLOCK_LENGTH);
+    statDepthMask(GL_TRUE);
+    statColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// fullDetail 为 true 时不做 LOD 和遮挡剔除，全部按最高精度绘制（生成俯视贴图时使用）
+void drawMaze(bool fullDetail = false) {
+    const Camare& cam = activeCamera();
+    int ci, cj;
+    worldToCell(cam.position[0], cam.position[1], ci, cj);
+
+    bool occlusion = occlusionEnabled && !fullDetail;
+    if (occlusion) prepareOcclusionQueries();
+
+    auto visitChunk = [&](int cy, int cx) {
+        int k = cy * chunksX + cx;
+        float dist = chunkDistance(cam, cy, cx);
+        int tier = LOD_NEAR;
+        if (!fullDetail && lodEnabled)
+            tier = updateChunkLod(k, dist);
+
+        // 没有墙的分块不值得查询；摄像机在包围盒里时包围盒会被近裁剪面切掉，直接当作可见
+        if (!occlusion || chunkWalls[k] == 0) {
+            drawChunk(cy, cx, tier, ci, cj);
+            chunksDrawn++;
+            return;
+        }
+        collectChunkQuery(k, false);
+        if (dist < MAP_BLOCK_LENGTH * 0.5f) chunkOccluded[k] = 0;
+
+        glBeginQuery(GL_SAMPLES_PASSED, chunkQuery[k]);
+        if (chunkOccluded[k]) {
+            drawChunkBounds(cy, cx);
+            statCells(std::min(MAZE_CHUNK_SIZE, mapData.height - cy * MAZE_CHUNK_SIZE) *
+                      std::min(MAZE_CHUNK_SIZE, mapData.width - cx * MAZE_CHUNK_SIZE), 0);
+            chunkQueryState[k] = CHUNK_QUERY_BOUNDS;
+            chunksOccluded++;
+        } else {
+            drawChunk(cy, cx, tier, ci, cj);
+            chunkQueryState[k] = CHUNK_QUERY_GEOMETRY;
+            chunksDrawn++;
+        }
+        glEndQuery(GL_SAMPLES_PASSED);
+    };
+
+    // 从摄像机所在的分块向外一圈一圈地画，近处的墙先写入深度，远处被挡住的片元直接被深度测试丢掉，
+    // 也让后面分块的遮挡查询能被前面的墙挡住
+    if (frontToBack) {
+        forEachRing(ci / MAZE_CHUNK_SIZE, cj / MAZE_CHUNK_SIZE, 0, 0, chunksY, chunksX, visitChunk);
+    } else {
+        for (int cy = 0; cy < chunksY; cy++)
+            for (int cx = 0; cx < chunksX; cx++)
+                visitChunk(cy, cx);
+    }
+}
+
+// ---------------- 全局视角的俯视贴图 ----------------
+// 全局视角几乎是从正上方看迷宫：把静态的墙体正交渲染一次到纹理里，
+// 之后每帧只画一张贴图，开销与迷宫大小无关。地图变化时才需要重建。
+void invalidateImpostor() {
+    impostorDirty = true;
+}
+
+void buildImpostor() {
+    GLint maxTex;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTex);
+    int limit = std::min((int)maxTex, IMPOSTOR_MAX_SIZE);
+    int texW = std::min(mapData.width * IMPOSTOR_TEXELS_PER_CELL, limit);
+    int texH = std::min(mapData.height * IMPOSTOR_TEXELS_PER_CELL, limit);
+    float worldW = mapData.width * MAP_BLOCK_LENGTH;
+    float worldH = mapData.height * MAP_BLOCK_LENGTH;
+
+    if (!impostorTex.id) glGenTextures(1, &impostorTex.id);
+    impostorTex.width = texW;
+    impostorTex.height = texH;
+    glBindTexture(GL_TEXTURE_2D, impostorTex.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texW, texH, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+    // 纹理可能比窗口大，按窗口大小分块渲染再拷进纹理
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    int tileW = viewport[2], tileH = viewport[3];
+
+    glClearColor(gray.r, gray.g, gray.b, 1);
+    for (int oy = 0; oy < texH; oy += tileH) {
+        for (int ox = 0; ox < texW; ox += tileW) {
+            int w = std::min(tileW, texW - ox);
+            int h = std::min(tileH, texH - oy);
+            glViewport(0, 0, w, h);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            glMatrixMode(GL_PROJECTION);
+            glLoadIdentity();
+            glOrtho(worldW * ox / texW, worldW * (ox + w) / texW,
+                    worldH * oy / texH, worldH * (oy + h) / texH,
+                    -MAP_BLOCK_LENGTH * 2, MAP_BLOCK_LENGTH * 2);
+            glMatrixMode(GL_MODELVIEW);
+            glLoadIdentity();
+
+            drawMaze(true);
+
+            glBindTexture(GL_TEXTURE_2D, impostorTex.id);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, ox, oy, 0, 0, w, h);
+        }
+    }
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    impostorDirty = false;
+    printf("Built global view impostor (%d x %d)\n", texW, texH);
+}
+
+// 贴在墙顶高度，贴图不写深度，只有玩家附近的墙补写深度，玩家方块随后照常绘制
+void drawImpostor() {
+    float worldW = mapData.width * MAP_BLOCK_LENGTH;
+    float worldH = mapData.height * MAP_BLOCK_LENGTH;
+    float z = MAP_BLOCK_LENGTH;
+
+    statDisable(GL_LIGHTING);
+    statDepthMask(GL_FALSE);
+    statEnable(GL_TEXTURE_2D);
+    statBindTexture(GL_TEXTURE_2D, impostorTex.id);
+    glColor3f(1, 1, 1);
+    statBegin(GL_QUADS);
+    glTexCoord2f(0, 0); statVertex3f(0, 0, z);
+    glTexCoord2f(1, 0); statVertex3f(worldW, 0, z);
+    glTexCoord2f(1, 1); statVertex3f(worldW, worldH, z);
+    glTexCoord2f(0, 1); statVertex3f(0, worldH, z);
+    statEnd();
+    statDisable(GL_TEXTURE_2D);
+    statDepthMask(GL_TRUE);
+
+    // 贴图本身没有深度，玩家方块会透过墙显示出来。全局视角的摄像机在玩家身后 10 格、高 15 格，
+    // 能挡住玩家的只有附近几格的墙：只给这些墙写深度、不写颜色，代价仍与迷宫大小无关
+    float top = worldH;
+    int i0 = std::max(0, player.x - IMPOSTOR_DEPTH_RADIUS), i1 = std::min(mapData.height, player.x + IMPOSTOR_DEPTH_RADIUS + 1);
+    int j0 = std::max(0, player.y - IMPOSTOR_DEPTH_RADIUS), j1 = std::min(mapData.width, player.y + IMPOSTOR_DEPTH_RADIUS + 1);
+    statColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            if (mapData.blocks[i][j] != MAP_BLOCK_CUBE) continue;
+            drawBox(j * MAP_BLOCK_LENGTH, top - (i + 1) * MAP_BLOCK_LENGTH, 0,
+                    (j + 1) * MAP_BLOCK_LENGTH, top - i * MAP_BLOCK_LENGTH, z);
+        }
+    }
+    statColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    statEnable(GL_LIGHTING);
+}
+
+void drawWorld() {
+    if (viewMode == VIEW_MODE_GLOBAL && useImpostor) drawImpostor();
+    else drawMaze();
 }
 
 // ---------------- HUD ----------------
@@ -372,7 +1156,15 @@ void HUD() {
     }
     
     char buf[128];
-    sprintf(buf, "视角:%s 位置:(%d,%d) 朝向:%s(%.0f°)", vname, player.x, player.y, faceName, playerAngle);
+    // 流式地图显示整张地图里的坐标，无尽迷宫的行号从起点那一行往前数
+    int gx = player.x + (streaming ? streamOriginY * STREAM_CHUNK : 0);
+    int gy = player.y + (streaming ? streamOriginX * STREAM_CHUNK : 0);
+    if (endless) gx = (int)(endlessDropped + mapData.height - 1 - player.x);
+    if (infinite) {
+        gx = (int)(player.x + infiniteOriginY * STREAM_CHUNK);
+        gy = (int)(player.y + infiniteOriginX * STREAM_CHUNK);
+    }
+    sprintf(buf, "视角:%s 位置:(%d,%d) 朝向:%s(%.0f°)", vname, gx, gy, faceName, playerAngle);
     drawText(10, H-20, buf);
     
     if (gameCompleted) {
@@ -383,6 +1175,63 @@ void HUD() {
         drawText(10, H-40, "前进：上箭头 | 转向：左/右箭头 | 切换视角：1/2/3");
     }
 
+    if (lodEnabled) {
+        glColor3f(0.8f, 0.8f, 0.8f);
+        sprintf(buf, "LOD 近:%d 中:%d 远:%d", lodCells[LOD_NEAR], lodCells[LOD_MID], lodCells[LOD_FAR]);
+        drawText(10, H-60, buf);
+    }
+    if (occlusionEnabled) {
+        glColor3f(0.8f, 0.8f, 0.8f);
+        sprintf(buf, "遮挡剔除 绘制:%d 剔除:%d 块", chunksDrawn, chunksOccluded);
+        drawText(10, H-80, buf);
+    }
+
+    // 渲染统计（上一帧）
+    float y = H-110;
+    if (showRenderStats) {
+        const RenderStats& r = renderStats().last;
+        glColor3f(0.5f, 0.9f, 1.0f);
+        sprintf(buf, "绘制调用:%u 图元:%u 顶点:%u", r.drawCalls, r.primitives, r.vertices);
+        drawText(10, y, buf);
+        sprintf(buf, "纹理绑定:%u 状态切换:%u 格子 考虑:%u 绘制:%u",
+                r.textureBinds, r.stateChanges, r.cellsConsidered, r.cellsDrawn);
+        drawText(10, y - 16, buf);
+        y -= 40;
+    }
+
+    // 分段耗时（最近 60 帧的平均值）
+    Profiler& prof = profiler();
+    if (prof.enabled) {
+        glColor3f(1.0f, 0.9f, 0.4f);
+        sprintf(buf, "帧 %.2f ms (%.0f fps)   CPU ms   GPU ms", prof.frameAvg,
+                prof.frameAvg > 0 ? 1000.0 / prof.frameAvg : 0.0);
+        drawText(10, y, buf);
+        for (int i = 0; i < prof.zoneCount; i++) {
+            const ProfileZone& z = prof.zones[i];
+            y -= 16;
+            if (z.gpu && prof.gpuTimers)
+                sprintf(buf, "%-14s %7.3f  %7.3f", z.name, z.cpuAvg, z.gpuAvg);
+            else
+                sprintf(buf, "%-14s %7.3f      -", z.name, z.cpuAvg);
+            drawText(10, y, buf);
+        }
+    }
+
+    // 硬件计数器（上一帧，单位：千）
+    PerfCounters& perf = perfCounters();
+    if (perf.enabled) {
+        y -= 24;
+        glColor3f(0.9f, 0.6f, 1.0f);
+        drawText(10, y, "区段            指令K    周期K  缓存未命中  分支失败");
+        for (int i = 0; i < perf.zoneCount; i++) {
+            const PerfZone& z = perf.zones[i];
+            y -= 16;
+            sprintf(buf, "%-14s %8.1f %8.1f %10llu %9llu", z.name, z.last[0] / 1000.0, z.last[1] / 1000.0,
+                    (unsigned long long)z.last[2], (unsigned long long)z.last[3]);
+            drawText(10, y, buf);
+        }
+    }
+
     glEnable(GL_LIGHTING);
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -472,8 +1321,118 @@ void drawCompletionScreen() {
     glMatrixMode(GL_MODELVIEW);
 }
 
+// ---------------- 录像 ----------------
+void startRecording() {
+    if (!recorderStart(recorder, recordPath, WINDOW_SIZE_WIDTH, WINDOW_SIZE_HEIGHT)) return;
+
+    // 两个 PBO 轮流异步读回，避免 glReadPixels 阻塞 display()
+    glGenBuffers(2, recordPBO);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPBO[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, recorder.width * recorder.height * 4, NULL, GL_STREAM_READ);
+        recordPBORepeat[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    recordPBOIndex = 0;
+    recordNextTime = now();
+}
+
+// 把上一次读回的 PBO 交给编码线程；队列满就丢帧
+void submitRecordPBO(int idx) {
+    if (!recordPBORepeat[idx]) return;
+    unsigned char* dst = recorderAcquire(recorder, recordPBORepeat[idx]);
+    recordPBORepeat[idx] = 0;
+    if (!dst) return;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPBO[idx]);
+    void* src = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (src) {
+        memcpy(dst, src, recorder.width * recorder.height * 4);
+        recorderCommit(recorder);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void captureFrame() {
+    if (!recorder.running) return;
+
+    // 按 60fps 的时间轴采样：渲染快时跳过，渲染慢时让这一帧重复多次
+    double t = now();
+    if (t < recordNextTime) return;
+    unsigned repeat = 1 + (unsigned)((t - recordNextTime) * RECORDER_FPS);
+    recordNextTime += repeat / (double)RECORDER_FPS;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadBuffer(GL_BACK);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPBO[recordPBOIndex]);
+    glReadPixels(0, 0, recorder.width, recorder.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    recordPBORepeat[recordPBOIndex] = repeat;
+
+    recordPBOIndex ^= 1;
+    submitRecordPBO(recordPBOIndex);
+}
+
+void stopRecording() {
+    if (!recorder.running) return;
+    submitRecordPBO(recordPBOIndex ^ 1);
+    glDeleteBuffers(2, recordPBO);
+    recordPBO[0] = recordPBO[1] = 0;
+    recorderStop(recorder);
+}
+
+// ---------------- 输入回放日志 ----------------
+uint32_t mapHash() {
+    uint32_t h = replayHash(2166136261u, &mapData.width, sizeof(mapData.width));
+    h = replayHash(h, &mapData.height, sizeof(mapData.height));
+    // 按每格一个 GLint 计算，和格子的存储方式无关
+    for (int i = 0; i < mapData.height; i++) {
+        for (int j = 0; j < mapData.width; j++) {
+            GLint b = mapData.blocks[i][j];
+            h = replayHash(h, &b, sizeof(b));
+        }
+    }
+    return h;
+}
+
+// 回放需要逐位复现的模拟状态
+uint32_t simStateHash() {
+    uint32_t h = replayHash(2166136261u, &player, sizeof(player));
+    h = replayHash(h, &playerAngle, sizeof(playerAngle));
+    h = replayHash(h, &t_move, sizeof(t_move));
+    h = replayHash(h, &moving, sizeof(moving));
+    h = replayHash(h, &gameCompleted, sizeof(gameCompleted));
+    h = replayHash(h, &completeAlpha, sizeof(completeAlpha));
+    return h;
+}
+
+void startInputLog(const char* path) {
+    replayOpenWrite(inputLog, path, mapData.width, mapData.height, mapHash());
+}
+
+void stopInputLog() {
+    replayCloseWrite(inputLog, simStateHash());
+}
+
+// 直接关闭窗口时 GLUT 会调用 exit()，这里只保证编码线程把文件写完、读盘线程退出
+void shutdownGame() {
+    stopInputLog();
+    mapStreamClose(mapStream);
+    recorderStop(recorder);
+    traceStop();
+    statCloseDump();
+    perfReport();
+}
+
 // ---------------- display ----------------
 void display() {
+    TRACE_SCOPE("display");
+    // 重建会用到后缓冲，必须在清屏之前
+    if (viewMode == VIEW_MODE_GLOBAL && useImpostor && impostorDirty) {
+        buildImpostor();
+    }
+
     glClearColor(gray.r, gray.g, gray.b, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -487,51 +1446,85 @@ void display() {
     float vx = px_src + (px_dst - px_src) * t_move;
     float vy = py_src + (py_dst - py_src) * t_move;
 
-    updateCameras(vx, vy);
+    {
+        PROFILE_ZONE("updateCameras");
+        updateCameras(vx, vy);
+    }
 
     // 根据当前视角设置摄像机
-    if (viewMode == VIEW_MODE_FRIST_PERSON) {
-        gluLookAt(cam1P.position[0], cam1P.position[1], cam1P.position[2],
-                  cam1P.lookAt[0], cam1P.lookAt[1], cam1P.lookAt[2], 0,0,1);
-    } else if (viewMode == VIEW_MODE_THIRD_PERSON) {
-        gluLookAt(cam3P.position[0], cam3P.position[1], cam3P.position[2],
-                  cam3P.lookAt[0], cam3P.lookAt[1], cam3P.lookAt[2], 0,0,1);
-    } else {
-        gluLookAt(camGlobal.position[0], camGlobal.position[1], camGlobal.position[2],
-                  camGlobal.lookAt[0], camGlobal.lookAt[1], camGlobal.lookAt[2], 0,0,1);
+    const Camare& cam = activeCamera();
+    gluLookAt(cam.position[0], cam.position[1], cam.position[2],
+              cam.lookAt[0], cam.lookAt[1], cam.lookAt[2], 0,0,1);
+
+    lodCells[LOD_NEAR] = lodCells[LOD_MID] = lodCells[LOD_FAR] = 0;
+    chunksDrawn = chunksOccluded = 0;
+    bool impostor = viewMode == VIEW_MODE_GLOBAL && useImpostor;
+    {
+        PROFILE_ZONE("drawMaze");
+        PERF_ZONE("drawMaze");
+        if (countOverdraw && occlusionEnabled && !impostor) {
+            // 查询不能嵌套，直接把各分块的查询结果加起来
+            drawWorld();
+            lastMazeSamples = resolveChunkQueries();
+        } else if (countOverdraw) {
+            glBeginQuery(GL_SAMPLES_PASSED, overdrawQuery);
+            drawWorld();
+            glEndQuery(GL_SAMPLES_PASSED);
+            glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT, &lastMazeSamples);
+        } else {
+            drawWorld();
+        }
     }
 
-    drawMaze();
-
     // 绘制玩家（绿色立方体）
-    glPushMatrix();
-    glTranslatef(vx, vy, PLAYER_CUBE_SIZE / 2.0f);
-    glRotatef(playerAngle, 0, 0, 1);
-    glTranslatef(-vx, -vy, -PLAYER_CUBE_SIZE/2.0f);
-    glColor3f(0.2, 1.0, 0.3);
-    drawCube(vx - PLAYER_CUBE_SIZE/2.0f,
-             vy - PLAYER_CUBE_SIZE/2.0f,
-             0, PLAYER_CUBE_SIZE, false);
-    glPopMatrix();
+    {
+        PROFILE_ZONE("player");
+        glPushMatrix();
+        glTranslatef(vx, vy, PLAYER_CUBE_SIZE / 2.0f);
+        glRotatef(playerAngle, 0, 0, 1);
+        glTranslatef(-vx, -vy, -PLAYER_CUBE_SIZE/2.0f);
+        glColor3f(0.2, 1.0, 0.3);
+        drawCube(vx - PLAYER_CUBE_SIZE/2.0f,
+                 vy - PLAYER_CUBE_SIZE/2.0f,
+                 0, PLAYER_CUBE_SIZE, false);
+        glPopMatrix();
+    }
+
+    {
+        PROFILE_ZONE("HUD");
+        HUD();
+    }
 
-    HUD();
-    
     if (gameCompleted) {
+        PROFILE_ZONE("completion");
         drawCompletionScreen();
     }
 
-    glutSwapBuffers();
+    {
+        PROFILE_ZONE("record");
+        captureFrame();
+    }
+    {
+        PROFILE_ZONE_CPU("swapBuffers");
+        glutSwapBuffers();
+    }
+    profileFrameEnd();
+    statFrameEnd();
+    perfFrameEnd();
 }
 
 // ---------------- idle ----------------
-void idle() {
-    float t = now();
-    float dt = t - lastTime;
-    lastTime = t;
+// 推进一步游戏逻辑；dt 由调用方给出，回放和基准测试用固定的模拟时间
+void stepGame(float dt) {
+    replayWriteDt(inputLog, dt);
+    if (streaming) streamTick();
+    if (endless) endlessTick();
+    if (infinite) infiniteTick();
 
     // 检查游戏是否完成
     if (!gameCompleted && mapData.blocks[player.x][player.y] == MAP_BLOCK_END) {
         gameCompleted = true;
+        invalidateImpostor();   // 终点方块不再绘制
         printf("恭喜！你完成了迷宫！\n");
     }
     
@@ -549,12 +1542,23 @@ void idle() {
             moving = false;
         }
     }
+}
+
+void idle() {
+    TRACE_SCOPE("idle");
+    float t = now();
+    float dt = t - lastTime;
+    lastTime = t;
+
+    stepGame(dt);
 
     glutPostRedisplay();
 }
 
 // ---------------- 按键处理 ----------------
 void special(int key, int, int) {
+    TRACE_SCOPE("special");
+    replayWriteKey(inputLog, true, key);
     // 如果游戏已完成，只允许切换视角
     if (gameCompleted) {
         if (key == GLUT_KEY_F1) { viewMode = VIEW_MODE_FRIST_PERSON; return; }
@@ -636,10 +1640,588 @@ void specialUp(int key, int, int) {
 }
 
 void keyboard(unsigned char key, int, int) {
-    if (key == 27) { exit(0); } // ESC
+    TRACE_SCOPE("keyboard");
+    replayWriteKey(inputLog, false, key);
+    if (key == 27) { stopInputLog(); stopRecording(); traceStop(); statCloseDump(); exit(0); } // ESC
     if (key == '1') viewMode = VIEW_MODE_FRIST_PERSON;
     if (key == '2') viewMode = VIEW_MODE_THIRD_PERSON;
     if (key == '3') viewMode = VIEW_MODE_GLOBAL;
+    if (key == 'i' || key == 'I') useImpostor = !useImpostor;
+    if (key == 'l' || key == 'L') lodEnabled = !lodEnabled;
+    if (key == 'o' || key == 'O') occlusionEnabled = !occlusionEnabled;
+    if (replaying) return;  // 回放时不开关录像、追踪这类有外部副作用的功能
+    if (key == 'p' || key == 'P') profileSetEnabled(!profiler().enabled);
+    if (key == 's' || key == 'S') showRenderStats = !showRenderStats;
+    if (key == 't' || key == 'T') {
+        if (traceEnabled()) traceFlush();
+        else traceStart(tracePath);
+    }
+    if (key == 'r' || key == 'R') {
+        if (recorder.running) stopRecording();
+        else startRecording();
+    }
+}
+
+// ---------------- headless ----------------
+// 隐藏窗口，按三种视角各渲染若干帧，统计迷宫通过深度测试的片元数（过度绘制）
+void runHeadless(int frames) {
+    glutHideWindow();
+    countOverdraw = true;
+    glGenQueries(1, &overdrawQuery);
+
+    const char* names[] = { "", "first person", "third person", "global" };
+    double pixels = (double)WINDOW_SIZE_WIDTH * WINDOW_SIZE_HEIGHT;
+    printf("Headless: %d frames per view, %s order\n", frames, frontToBack ? "front-to-back" : "row-major");
+    for (ViewMode mode = VIEW_MODE_FRIST_PERSON; mode <= VIEW_MODE_GLOBAL; mode++) {
+        viewMode = mode;
+        double samples = 0;
+        double cells[3] = {0, 0, 0};
+        double drawn = 0, occluded = 0;
+        double calls = 0, verts = 0, binds = 0, states = 0;
+        double t0 = now();
+        for (int f = 0; f < frames; f++) {
+            display();
+            samples += lastMazeSamples;
+            for (int k = 0; k < 3; k++) cells[k] += lodCells[k];
+            drawn += chunksDrawn;
+            occluded += chunksOccluded;
+            const RenderStats& r = renderStats().last;
+            calls += r.drawCalls;
+            verts += r.vertices;
+            binds += r.textureBinds;
+            states += r.stateChanges;
+        }
+        glFinish();
+        double ms = (now() - t0) * 1000.0 / frames;
+        printf("  %-12s samples/frame %10.0f  overdraw %.3f  %.3f ms/frame  LOD cells near/mid/far %.0f/%.0f/%.0f\n",
+               names[mode], samples / frames, samples / frames / pixels, ms,
+               cells[LOD_NEAR] / frames, cells[LOD_MID] / frames, cells[LOD_FAR] / frames);
+        printf("  %-12s chunks drawn/occluded %.1f/%.1f\n", "", drawn / frames, occluded / frames);
+        printf("  %-12s draw calls %.0f  vertices %.0f  texture binds %.0f  state changes %.0f\n", "",
+               calls / frames, verts / frames, binds / frames, states / frames);
+
+        Profiler& prof = profiler();
+        for (int i = 0; prof.enabled && i < prof.zoneCount; i++)
+            printf("  %-12s %-14s cpu %7.3f ms  gpu %7.3f ms\n", "", prof.zones[i].name,
+                   prof.zones[i].cpuAvg, prof.zones[i].gpuAvg);
+    }
+
+    glDeleteQueries(1, &overdrawQuery);
+}
+
+// ---------------- 脚本回放基准测试 ----------------
+// 脚本每行一个按键事件："<秒> <键>"，键可以是 UP/LEFT/RIGHT/DOWN/F1/F2/F3 或单个字符（如 1、2、3），# 开头为注释。
+// 以固定步长推进模拟时间，事件在对应的模拟时刻送进 special()/keyboard()，每一步都渲染一帧，
+// 不等待真实时间，尽可能快地跑完，最后报告帧率和帧耗时分位数。
+struct ScriptEvent {
+    double time;
+    bool special;
+    int key;
+};
+
+bool loadInputScript(const char* path, std::vector<ScriptEvent>& events) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        printf("Benchmark: cannot open script %s\n", path);
+        return false;
+    }
+    char line[256];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        double t;
+        char name[64];
+        if (line[0] == '#' || sscanf(line, "%lf %63s", &t, name) != 2) continue;
+
+        ScriptEvent e = { t, true, 0 };
+        if (strcmp(name, "UP") == 0) e.key = GLUT_KEY_UP;
+        else if (strcmp(name, "DOWN") == 0) e.key = GLUT_KEY_DOWN;
+        else if (strcmp(name, "LEFT") == 0) e.key = GLUT_KEY_LEFT;
+        else if (strcmp(name, "RIGHT") == 0) e.key = GLUT_KEY_RIGHT;
+        else if (strcmp(name, "F1") == 0) e.key = GLUT_KEY_F1;
+        else if (strcmp(name, "F2") == 0) e.key = GLUT_KEY_F2;
+        else if (strcmp(name, "F3") == 0) e.key = GLUT_KEY_F3;
+        else if (name[1] == '\0' && name[0] != 27) { e.special = false; e.key = (unsigned char)name[0]; }
+        else {
+            printf("Benchmark: %s:%d: unknown key '%s'\n", path, lineNo, name);
+            continue;
+        }
+        events.push_back(e);
+    }
+    fclose(f);
+    std::stable_sort(events.begin(), events.end(),
+                     [](const ScriptEvent& a, const ScriptEvent& b) { return a.time < b.time; });
+    return true;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t k = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[k];
+}
+
+void runBenchmark(const char* scriptPath, float dt) {
+    // dt 不是正数时模拟时间永远走不到结尾
+    if (!(dt > 0)) {
+        printf("Benchmark: --bench-dt must be a positive number of seconds\n");
+        return;
+    }
+    std::vector<ScriptEvent> events;
+    if (!loadInputScript(scriptPath, events)) return;
+    glutHideWindow();
+
+    // 最后一个事件之后再多跑一秒，让移动插值和完成画面走完
+    double endTime = (events.empty() ? 0 : events.back().time) + 1.0;
+    size_t next = 0;
+    unsigned steps = 0;
+    double simTime = 0;
+    std::vector<double> frameMs;
+
+    double t0 = now();
+    while (simTime <= endTime) {
+        while (next < events.size() && events[next].time <= simTime) {
+            const ScriptEvent& e = events[next++];
+            if (e.special) special(e.key, 0, 0);
+            else keyboard((unsigned char)e.key, 0, 0);
+        }
+
+        double f0 = now();
+        stepGame(dt);
+        display();
+        glFinish();
+        frameMs.push_back((now() - f0) * 1000.0);
+
+        steps++;
+        simTime = steps * (double)dt;
+    }
+    double wall = now() - t0;
+
+    std::sort(frameMs.begin(), frameMs.end());
+    printf("Benchmark %s: %zu events, %u steps (%.2f s simulated, dt %.4f s)\n",
+           scriptPath, events.size(), steps, simTime, dt);
+    printf("  wall %.3f s  %.1f fps  (%.1fx real time)\n", wall, steps / wall, simTime / wall);
+    printf("  frame ms  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+           percentile(frameMs, 0.50), percentile(frameMs, 0.90), percentile(frameMs, 0.99), frameMs.back());
+    printf("  final player (%d,%d) face %d angle %.1f completed %d\n",
+           player.x, player.y, player.face, playerAngle, gameCompleted ? 1 : 0);
+}
+
+// ---------------- 输入日志回放 ----------------
+// 按记录的顺序把按键送进 special()/keyboard()，把 dt 送进 stepGame()，不渲染也不等待，
+// 最后和日志结尾记录的状态哈希比较
+void runReplay(const char* path) {
+    ReplayReader log;
+    if (!replayOpenRead(log, path)) return;
+    if (log.width != mapData.width || log.height != mapData.height || log.mapHash != mapHash()) {
+        printf("Replay: %s was recorded on a different map (%dx%d)\n", path, log.width, log.height);
+        return;
+    }
+    glutHideWindow();
+    replaying = true;
+
+    unsigned long long frames = 0, events = 0;
+    double simTime = 0;
+    uint32_t expected = 0;
+    bool ended = false;
+    double t0 = now();
+    for (;;) {
+        float dt;
+        int key;
+        int type = replayNext(log, dt, key, expected);
+        if (type == REPLAY_DT) {
+            stepGame(dt);
+            simTime += dt;
+            frames++;
+        } else if (type == REPLAY_SPECIAL) {
+            special(key, 0, 0);
+            events++;
+        } else if (type == REPLAY_KEYBOARD) {
+            events++;
+            if (key == 27) continue;    // ESC 之后就是日志结尾
+            keyboard((unsigned char)key, 0, 0);
+        } else {
+            ended = type == REPLAY_END;
+            break;
+        }
+    }
+    double wall = now() - t0;
+    replaying = false;
+
+    printf("Replay %s: %llu frames, %llu events, %.2f s simulated in %.4f s (%.0fx real time)\n",
+           path, frames, events, simTime, wall, wall > 0 ? simTime / wall : 0.0);
+    printf("  final player (%d,%d) face %d angle %a t_move %a completed %d\n",
+           player.x, player.y, player.face, playerAngle, t_move, gameCompleted ? 1 : 0);
+    if (!ended) printf("  log is truncated, no final state to compare\n");
+    else if (expected == simStateHash()) printf("  state matches the recording (hash %08x)\n", expected);
+    else printf("  STATE MISMATCH: recorded %08x, replayed %08x\n", expected, simStateHash());
+}
+
+// ---------------- 地图规模基准测试 ----------------
+// 从 10x10 到 4096x4096 生成一组迷宫，分别计时分块构建、可见性分级、canMove 查询、
+// 起点到终点的寻路和无窗口渲染，结果按文件扩展名写成 CSV 或 JSON，方便跨版本对比规模上的退化
+static const int SUITE_SIZES[] = { 10, 32, 64, 100, 256, 1024, 4096 };
+#define SUITE_CANMOVE_LOOKUPS 4000000
+#define SUITE_VISIBILITY_VIEWS 64
+#define SUITE_FRAMES 10
+#define SUITE_RLE_DECODE_BYTES (256 << 20)  // 每种尺寸至少解压这么多字节再计时
+#define SUITE_RENDER_MAX 1024   // 更大的地图只测地图本身，渲染时间记为 -1（逐格立即模式绘制在这个规模上要几分钟）
+
+struct SuiteResult {
+    int size;
+    long long walls;
+    double chunkBuildMs;
+    double visibilityMs;        // 每个视点
+    double canMoveNs;           // 每次查询
+    double pathMs;
+    int pathLength;
+    double frameMs[3];          // 三种视角的平均帧耗时
+    long long faces, deadEnds, reachable;
+    double facesLoopMs, facesBitMs;         // 逐格循环 / 墙位图
+    double deadEndsLoopMs, deadEndsBitMs;
+    double floodMs;
+    double junctionMs[2], bfsMs[2];         // 按行存放 / 8x8 块
+    long long rleBytes;                     // 按 64x64 块压缩后的总字节数
+    double rleRatio, rleDecodeGBps;         // 解压吞吐按解压后的字节数算
+    double genMs[MAZE_ALGO_COUNT];          // 各生成算法生成同样大小的完美迷宫
+    double genRegionsMs;                    // 分区并行生成（Kruskal，全部硬件线程）
+    long long components, junctions;       // 加载时分析的结果
+    double analysisMs;
+};
+
+// 逐格读 blocks[i][j] 的对照实现，用来衡量墙位图的收益
+bool suiteWallAt(int i, int j, bool outside) {
+    if (i < 0 || j < 0 || i >= mapData.height || j >= mapData.width) return outside;
+    return mapData.blocks[i][j] == MAP_BLOCK_CUBE;
+}
+
+long long loopExposedFaces() {
+    long long faces = 0;
+    for (int i = 0; i < mapData.height; i++)
+        for (int j = 0; j < mapData.width; j++)
+            if (mapData.blocks[i][j] == MAP_BLOCK_CUBE)
+                faces += !suiteWallAt(i - 1, j, false) + !suiteWallAt(i + 1, j, false) +
+                         !suiteWallAt(i, j - 1, false) + !suiteWallAt(i, j + 1, false);
+    return faces;
+}
+
+// 邻居密集的访问，只通过 blocks.get() 读格子，用来比较两种存放方式：
+// 逐格读四个邻居统计岔路口（三个以上方向可走的空地）
+long long layoutJunctions(const Map& m) {
+    long long count = 0;
+    for (int i = 1; i + 1 < m.height; i++)
+        for (int j = 1; j + 1 < m.width; j++)
+            if (m.blocks.get(i, j) != MAP_BLOCK_CUBE)
+                count += (m.blocks.get(i - 1, j) != MAP_BLOCK_CUBE) + (m.blocks.get(i + 1, j) != MAP_BLOCK_CUBE) +
+                         (m.blocks.get(i, j - 1) != MAP_BLOCK_CUBE) + (m.blocks.get(i, j + 1) != MAP_BLOCK_CUBE) >= 3;
+    return count;
+}
+
+// 从 (si, sj) 出发的广度优先搜索，返回可到达的格子数
+long long layoutBfs(const Map& m, int si, int sj) {
+    size_t w = (size_t)m.width;
+    std::vector<uint8_t> seen(w * m.height, 0);
+    std::vector<size_t> queue;
+    seen[si * w + sj] = 1;
+    queue.push_back(si * w + sj);
+    static const int DI[4] = { -1, 1, 0, 0 }, DJ[4] = { 0, 0, -1, 1 };
+    for (size_t head = 0; head < queue.size(); head++) {
+        int i = (int)(queue[head] / w), j = (int)(queue[head] % w);
+        for (int d = 0; d < 4; d++) {
+            int ni = i + DI[d], nj = j + DJ[d];
+            if (ni < 0 || nj < 0 || ni >= m.height || nj >= m.width) continue;
+            if (seen[ni * w + nj] || m.blocks.get(ni, nj) == MAP_BLOCK_CUBE) continue;
+            seen[ni * w + nj] = 1;
+            queue.push_back(ni * w + nj);
+        }
+    }
+    return (long long)queue.size();
+}
+
+long long loopDeadEnds() {
+    long long count = 0;
+    for (int i = 0; i < mapData.height; i++)
+        for (int j = 0; j < mapData.width; j++)
+            if (mapData.blocks[i][j] != MAP_BLOCK_CUBE)
+                count += suiteWallAt(i - 1, j, true) + suiteWallAt(i + 1, j, true) +
+                         suiteWallAt(i, j - 1, true) + suiteWallAt(i, j + 1, true) == 3;
+    return count;
+}
+
+void writeSuiteResults(const char* path, float density, uint64_t seed, const std::vector<SuiteResult>& results) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("Suite: cannot open %s\n", path);
+        return;
+    }
+    size_t len = strlen(path);
+    bool json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+    if (json) {
+        fprintf(f, "{\"density\":%.3f,\"seed\":%llu,\"results\":[\n", density, (unsigned long long)seed);
+        for (size_t k = 0; k < results.size(); k++) {
+            const SuiteResult& r = results[k];
+            fprintf(f, "  {\"size\":%d,\"walls\":%lld,\"chunk_build_ms\":%.4f,\"visibility_ms\":%.4f,"
+                       "\"canmove_ns\":%.3f,\"path_ms\":%.4f,\"path_length\":%d,"
+                       "\"frame_ms_first\":%.4f,\"frame_ms_third\":%.4f,\"frame_ms_global\":%.4f,"
+                       "\"faces\":%lld,\"faces_loop_ms\":%.4f,\"faces_bitboard_ms\":%.4f,"
+                       "\"dead_ends\":%lld,\"dead_ends_loop_ms\":%.4f,\"dead_ends_bitboard_ms\":%.4f,"
+                       "\"reachable\":%lld,\"flood_fill_ms\":%.4f,"
+                       "\"junctions_row_major_ms\":%.4f,\"junctions_tiled_ms\":%.4f,"
+                       "\"bfs_row_major_ms\":%.4f,\"bfs_tiled_ms\":%.4f,"
+                       "\"rle_bytes\":%lld,\"rle_ratio\":%.3f,\"rle_decode_gbps\":%.3f,"
+                       "\"gen_backtracker_ms\":%.4f,\"gen_kruskal_ms\":%.4f,\"gen_wilson_ms\":%.4f,"
+                       "\"gen_prim_ms\":%.4f,\"gen_regions_ms\":%.4f,"
+                       "\"components\":%lld,\"junctions\":%lld,\"analysis_ms\":%.4f}%s\n",
+                    r.size, r.walls, r.chunkBuildMs, r.visibilityMs, r.canMoveNs, r.pathMs, r.pathLength,
+                    r.frameMs[0], r.frameMs[1], r.frameMs[2], r.faces, r.facesLoopMs, r.facesBitMs,
+                    r.deadEnds, r.deadEndsLoopMs, r.deadEndsBitMs, r.reachable, r.floodMs,
+                    r.junctionMs[0], r.junctionMs[1], r.bfsMs[0], r.bfsMs[1],
+                    r.rleBytes, r.rleRatio, r.rleDecodeGBps, r.genMs[MAZE_ALGO_BACKTRACKER],
+                    r.genMs[MAZE_ALGO_KRUSKAL], r.genMs[MAZE_ALGO_WILSON], r.genMs[MAZE_ALGO_PRIM], r.genRegionsMs,
+                    r.components, r.junctions, r.analysisMs, k + 1 < results.size() ? "," : "");
+        }
+        fputs("]}\n", f);
+    } else {
+        fputs("size,walls,chunk_build_ms,visibility_ms,canmove_ns,path_ms,path_length,"
+              "frame_ms_first,frame_ms_third,frame_ms_global,faces,faces_loop_ms,faces_bitboard_ms,"
+              "dead_ends,dead_ends_loop_ms,dead_ends_bitboard_ms,reachable,flood_fill_ms,"
+              "junctions_row_major_ms,junctions_tiled_ms,bfs_row_major_ms,bfs_tiled_ms,"
+              "rle_bytes,rle_ratio,rle_decode_gbps,gen_backtracker_ms,gen_kruskal_ms,gen_wilson_ms,gen_prim_ms,"
+              "gen_regions_ms,components,junctions,analysis_ms\n", f);
+        for (size_t k = 0; k < results.size(); k++) {
+            const SuiteResult& r = results[k];
+            fprintf(f, "%d,%lld,%.4f,%.4f,%.3f,%.4f,%d,%.4f,%.4f,%.4f,%lld,%.4f,%.4f,%lld,%.4f,%.4f,%lld,%.4f,"
+                       "%.4f,%.4f,%.4f,%.4f,%lld,%.3f,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%lld,%.4f\n",
+                    r.size, r.walls, r.chunkBuildMs, r.visibilityMs, r.canMoveNs, r.pathMs, r.pathLength,
+                    r.frameMs[0], r.frameMs[1], r.frameMs[2], r.faces, r.facesLoopMs, r.facesBitMs,
+                    r.deadEnds, r.deadEndsLoopMs, r.deadEndsBitMs, r.reachable, r.floodMs,
+                    r.junctionMs[0], r.junctionMs[1], r.bfsMs[0], r.bfsMs[1],
+                    r.rleBytes, r.rleRatio, r.rleDecodeGBps, r.genMs[MAZE_ALGO_BACKTRACKER],
+                    r.genMs[MAZE_ALGO_KRUSKAL], r.genMs[MAZE_ALGO_WILSON], r.genMs[MAZE_ALGO_PRIM], r.genRegionsMs,
+                    r.components, r.junctions, r.analysisMs);
+        }
+    }
+    fclose(f);
+    printf("Suite results written to %s\n", path);
+}
+
+// 房间列数除以 MAZE_REGION_ROOMS 余 1 时最后一列区只有一列房间（宽 515、516）。
+// 这种宽度用每种算法分区生成一次，必须连通，而且外圈全是墙
+void suiteCheckNarrowRegions(uint64_t seed) {
+    static const int WIDTHS[] = { 515, 516 };
+    for (int w = 0; w < 2; w++) {
+        for (int a = 0; a < MAZE_ALGO_COUNT; a++) {
+            Map m;
+            generateMazeRegions(m, WIDTHS[w], 41, 1.0f, seed, a, 0);
+            MapAnalysis analysis = mapAnalyze(m);
+            int border = 0;
+            for (int i = 0; i < m.height; i++) border += !m.blocks.isWall(i, 0) + !m.blocks.isWall(i, m.width - 1);
+            for (int j = 0; j < m.width; j++) border += !m.blocks.isWall(0, j) + !m.blocks.isWall(m.height - 1, j);
+            if (analysis.components != 1 || analysis.pathLength < 0 || border)
+                printf("  MISMATCH: %s regions %dx41 has %lld components, %d open border cells\n",
+                       MAZE_ALGO_NAMES[a], WIDTHS[w], analysis.components, border);
+        }
+    }
+}
+
+// 输入日志的 dt 编码：交替出现的值会在写出连续段时改变缓存的顺序，随机序列覆盖各种组合
+void suiteCheckReplayDts(uint64_t seed) {
+    static const float VALUES[] = { 0.5f, 0.25f, 1.0f / 60.0f, 1.0f / 30.0f, 0.1f, 0.0f };
+    float alternating[] = { 0.5f, 0.25f, 0.5f, 0.25f };
+    long bad = replayCheckDts(alternating, 4);
+    if (bad >= 0) printf("  MISMATCH: input log dt a,b,a,b differs at %ld\n", bad);
+    MazeRng rng(seed);
+    std::vector<float> dts(4096);
+    for (size_t i = 0; i < dts.size(); i++)
+        dts[i] = rng.below(4) == 0 && i > 0 ? dts[i - 1] : VALUES[rng.below(6)];
+    bad = replayCheckDts(dts.data(), dts.size());
+    if (bad >= 0) printf("  MISMATCH: input log dt sequence differs at %ld\n", bad);
+}
+
+void runBenchSuite(const char* outPath, float density, uint64_t seed) {
+    glutHideWindow();
+    std::vector<SuiteResult> results;
+    printf("Suite: density %.2f seed %llu\n", density, (unsigned long long)seed);
+    suiteCheckNarrowRegions(seed);
+    suiteCheckReplayDts(seed);
+    printf("  %6s %10s %10s %10s %9s %10s %8s %10s %10s %10s\n", "size", "walls", "chunks ms", "visib ms",
+           "canMove ns", "path ms", "path", "first ms", "third ms", "global ms");
+
+    for (size_t s = 0; s < sizeof(SUITE_SIZES) / sizeof(SUITE_SIZES[0]); s++) {
+        int n = SUITE_SIZES[s];
+        if (!generateMaze(mapData, n, n, density, seed)) {
+            printf("  %6d skipped (MAP_MAX is %d)\n", n, MAP_MAX);
+            continue;
+        }
+        resetMap();
+        SuiteResult r;
+        memset(&r, 0, sizeof(r));
+        r.size = n;
+
+        // 生成：每种算法各生成一张同样大小的完美迷宫
+        for (int a = 0; a < MAZE_ALGO_COUNT; a++) {
+            Map scratch;
+            double g0 = now();
+            generateMaze(scratch, n, n, 1.0f, seed, a);
+            r.genMs[a] = (now() - g0) * 1000.0;
+        }
+        // 分区生成用 Kruskal：整张图时它的并查集最不命中缓存，分区之后每个区的并查集都放得进缓存
+        {
+            Map scratch;
+            double g0 = now();
+            generateMazeRegions(scratch, n, n, 1.0f, seed, MAZE_ALGO_KRUSKAL, 0);
+            r.genRegionsMs = (now() - g0) * 1000.0;
+        }
+
+        double t0 = now();
+        rebuildChunks();
+        r.chunkBuildMs = (now() - t0) * 1000.0;
+        for (int k = 0; k < chunksX * chunksY; k++) r.walls += chunkWalls[k];
+
+        // 可见性：和 drawMaze 一样按环遍历分块并分级，但不发出任何 GL 调用
+        MazeRng rng(seed);
+        unsigned tiers[3] = {0, 0, 0};
+        t0 = now();
+        for (int v = 0; v < SUITE_VISIBILITY_VIEWS; v++) {
+            Camare cam = cam1P;
+            cam.position[0] = (rng.below(n) + 0.5f) * MAP_BLOCK_LENGTH;
+            cam.position[1] = (rng.below(n) + 0.5f) * MAP_BLOCK_LENGTH;
+            int ci, cj;
+            worldToCell(cam.position[0], cam.position[1], ci, cj);
+            forEachRing(ci / MAZE_CHUNK_SIZE, cj / MAZE_CHUNK_SIZE, 0, 0, chunksY, chunksX, [&](int cy, int cx) {
+                tiers[updateChunkLod(cy * chunksX + cx, chunkDistance(cam, cy, cx))]++;
+            });
+        }
+        r.visibilityMs = (now() - t0) * 1000.0 / SUITE_VISIBILITY_VIEWS;
+        chunkLod.assign(chunkLod.size(), LOD_NEAR);
+
+        // canMove：随机坐标，包括越界的
+        unsigned passable = 0;
+        uint32_t x = (uint32_t)seed | 1;
+        t0 = now();
+        for (int k = 0; k < SUITE_CANMOVE_LOOKUPS; k++) {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            passable += canMove((int)(x & 0xFFFF) % (n + 2) - 1, (int)(x >> 16) % (n + 2) - 1);
+        }
+        r.canMoveNs = (now() - t0) * 1.0e9 / SUITE_CANMOVE_LOOKUPS;
+
+        GLint ei = -1, ej = -1;
+        mapData.findMarker(MAP_BLOCK_END, ei, ej);
+        t0 = now();
+        r.pathLength = shortestPathLength(player.x, player.y, ei, ej);
+        r.pathMs = (now() - t0) * 1000.0;
+
+        // 墙相关的查询：逐格循环和墙位图各算一遍，结果必须一致
+        t0 = now();
+        long long faces = loopExposedFaces();
+        r.facesLoopMs = (now() - t0) * 1000.0;
+        t0 = now();
+        r.faces = bitExposedFaces(mapData);
+        r.facesBitMs = (now() - t0) * 1000.0;
+        t0 = now();
+        long long deadEnds = loopDeadEnds();
+        r.deadEndsLoopMs = (now() - t0) * 1000.0;
+        t0 = now();
+        r.deadEnds = bitDeadEnds(mapData);
+        r.deadEndsBitMs = (now() - t0) * 1000.0;
+        if (faces != r.faces || deadEnds != r.deadEnds)
+            printf("  MISMATCH: faces %lld/%lld dead ends %lld/%lld\n", faces, r.faces, deadEnds, r.deadEnds);
+        std::vector<uint64_t> reach;
+        t0 = now();
+        r.reachable = bitFloodFill(mapData, player.x, player.y, reach);
+        r.floodMs = (now() - t0) * 1000.0;
+
+        // 加载时的分析一次算出的几项要和上面分别算的一致
+        t0 = now();
+        MapAnalysis analysis = mapAnalyze(mapData);
+        r.analysisMs = (now() - t0) * 1000.0;
+        r.components = analysis.components;
+        r.junctions = analysis.junctions;
+        if (analysis.reachable != r.reachable || analysis.pathLength != r.pathLength || analysis.deadEnds != r.deadEnds)
+            printf("  MISMATCH: analysis reachable %lld/%lld path %d/%d dead ends %lld/%lld\n", analysis.reachable,
+                   r.reachable, analysis.pathLength, r.pathLength, analysis.deadEnds, r.deadEnds);
+
+        // 同一张地图分别按行和按 8x8 块存放，跑同样的邻居密集访问
+        long long layoutCheck[2][2];
+        for (int layout = 0; layout < 2; layout++) {
+            Map copy = mapData;
+            copy.setTiled(layout == 1);
+            t0 = now();
+            layoutCheck[layout][0] = layoutJunctions(copy);
+            r.junctionMs[layout] = (now() - t0) * 1000.0;
+            t0 = now();
+            layoutCheck[layout][1] = layoutBfs(copy, player.x, player.y);
+            r.bfsMs[layout] = (now() - t0) * 1000.0;
+        }
+        if (layoutCheck[0][0] != layoutCheck[1][0] || layoutCheck[0][1] != layoutCheck[1][1] ||
+            layoutCheck[0][1] != r.reachable)
+            printf("  MISMATCH: layouts disagree\n");
+
+        // 按流式地图的 64x64 块逐块压缩，再反复逐块解压；第一遍顺便核对内容
+        int rleChunksX = (n + STREAM_CHUNK - 1) / STREAM_CHUNK, rleChunksY = rleChunksX;
+        std::vector<uint8_t> packed;
+        std::vector<size_t> packedAt;
+        std::vector<uint64_t> original((size_t)rleChunksX * rleChunksY * STREAM_CHUNK * STREAM_CHUNK_WORDS);
+        Map rows = mapData;
+        rows.setTiled(false);
+        for (int cy = 0; cy < rleChunksY; cy++) {
+            for (int cx = 0; cx < rleChunksX; cx++) {
+                uint64_t* chunk = &original[packedAt.size() * STREAM_CHUNK * STREAM_CHUNK_WORDS];
+                mapStreamGatherChunk(rows, cy, cx, chunk);
+                packedAt.push_back(packed.size());
+                mapStreamCompressChunk(chunk, packed);
+            }
+        }
+        packedAt.push_back(packed.size());
+        double rawBytes = (double)original.size() * sizeof(uint64_t);
+        r.rleBytes = (long long)packed.size();
+        r.rleRatio = rawBytes / packed.size();
+        int reps = std::max(1, (int)(SUITE_RLE_DECODE_BYTES / rawBytes));
+        uint64_t decoded[STREAM_CHUNK * STREAM_CHUNK_WORDS];
+        int rleBad = 0;
+        t0 = now();
+        for (int rep = 0; rep < reps; rep++) {
+            for (size_t k = 0; k + 1 < packedAt.size(); k++) {
+                if (!mapStreamDecompressChunk(&packed[packedAt[k]], packedAt[k + 1] - packedAt[k], decoded) ||
+                    (rep == 0 && memcmp(decoded, &original[k * STREAM_CHUNK * STREAM_CHUNK_WORDS], sizeof(decoded))))
+                    rleBad++;
+            }
+        }
+        r.rleDecodeGBps = rawBytes * reps / (now() - t0) / 1e9;
+        if (rleBad) printf("  MISMATCH: %d chunks did not decompress to the original\n", rleBad);
+
+        for (ViewMode mode = VIEW_MODE_FRIST_PERSON; mode <= VIEW_MODE_GLOBAL; mode++) {
+            r.frameMs[mode - 1] = -1;
+            if (n > SUITE_RENDER_MAX) continue;
+            viewMode = mode;
+            display();      // 第一帧可能要重建俯视贴图，不计时
+            glFinish();
+            t0 = now();
+            for (int f = 0; f < SUITE_FRAMES; f++) display();
+            glFinish();
+            r.frameMs[mode - 1] = (now() - t0) * 1000.0 / SUITE_FRAMES;
+        }
+        viewMode = VIEW_MODE_FRIST_PERSON;
+
+        printf("  %6d %10lld %10.3f %10.4f %9.2f %10.3f %8d %10.3f %10.3f %10.3f\n", n, r.walls,
+               r.chunkBuildMs, r.visibilityMs, r.canMoveNs, r.pathMs, r.pathLength,
+               r.frameMs[0], r.frameMs[1], r.frameMs[2]);
+        printf("  %6s faces %lld: loop %.3f ms, bitboard %.3f ms | dead ends %lld: loop %.3f ms, bitboard %.3f ms"
+               " | flood fill %lld cells %.3f ms\n", "", r.faces, r.facesLoopMs, r.facesBitMs,
+               r.deadEnds, r.deadEndsLoopMs, r.deadEndsBitMs, r.reachable, r.floodMs);
+        printf("  %6s junctions: row-major %.3f ms, tiled %.3f ms | BFS: row-major %.3f ms, tiled %.3f ms\n", "",
+               r.junctionMs[0], r.junctionMs[1], r.bfsMs[0], r.bfsMs[1]);
+        printf("  %6s chunk RLE: %lld bytes (%.2fx), decompress %.2f GB/s\n", "", r.rleBytes, r.rleRatio,
+               r.rleDecodeGBps);
+        printf("  %6s generate: backtracker %.3f ms, kruskal %.3f ms, wilson %.3f ms, prim %.3f ms,"
+               " kruskal regions (%u threads) %.3f ms\n", "", r.genMs[MAZE_ALGO_BACKTRACKER],
+               r.genMs[MAZE_ALGO_KRUSKAL], r.genMs[MAZE_ALGO_WILSON], r.genMs[MAZE_ALGO_PRIM],
+               std::max(1u, std::thread::hardware_concurrency()), r.genRegionsMs);
+        printf("  %6s analysis: %lld components, %lld junctions, %.3f ms\n", "", r.components, r.junctions,
+               r.analysisMs);
+        if (passable == 0 || tiers[LOD_NEAR] == 0) printf("  (unexpected: no passable cells or near chunks)\n");
+        results.push_back(r);
+    }
+    if (outPath) writeSuiteResults(outPath, density, seed, results);
 }
 
 // ---------------- main ----------------
@@ -650,7 +2232,149 @@ int main(int argc, char** argv) {
     glutInitWindowPosition(WINDOW_POSITION_X, WINDOW_POSITION_Y);
     glutCreateWindow("迷宫游戏 - 仅能前进模式");
 
+    // 追踪和硬件计数器要在加载资源之前开启，地图文件和流式地图要在 initGame() 之前打开
+    traceSetThreadName("main");
+    const char* mapPath = NULL;
+    MapLoadOptions mapOptions;
+    const char* streamPath = NULL;
+    int streamBudget = STREAM_DEFAULT_BUDGET_MB;
+    int endlessWidth = 0;
+    bool infiniteMaze = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+            traceStart(tracePath);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perfInit();
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            mapPath = argv[++i];
+        } else if (strcmp(argv[i], "--map-populate") == 0) {
+            mapOptions.populate = true;
+        } else if (strcmp(argv[i], "--map-huge-pages") == 0) {
+            mapOptions.hugePages = true;
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            streamPath = argv[++i];
+        } else if (strcmp(argv[i], "--stream-budget") == 0 && i + 1 < argc) {
+            streamBudget = atoi(argv[++i]);
+            if (streamBudget <= 0) {
+                printf("--stream-budget must be a positive number of MB, using %d\n", STREAM_DEFAULT_BUDGET_MB);
+                streamBudget = STREAM_DEFAULT_BUDGET_MB;
+            }
+        } else if (strcmp(argv[i], "--endless") == 0 && i + 1 < argc) {
+            endlessWidth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--infinite") == 0) {
+            infiniteMaze = true;
+        } else if (strcmp(argv[i], "--analysis") == 0) {
+            mapAnalysisMode = MAP_ANALYSIS_ON;
+        } else if (strcmp(argv[i], "--no-analysis") == 0) {
+            mapAnalysisMode = MAP_ANALYSIS_OFF;
+        } else if (strcmp(argv[i], "--gen") == 0 && i + 1 < argc) {
+            genAlgorithm = mazeAlgorithmByName(argv[++i]);
+            if (genAlgorithm < 0) printf("Unknown maze generator %s (backtracker, kruskal, wilson, prim)\n", argv[i]);
+        } else if (strcmp(argv[i], "--gen-size") == 0 && i + 1 < argc) {
+            // <n> 或 <宽>x<高>
+            if (sscanf(argv[++i], "%dx%d", &genWidth, &genHeight) == 1) genHeight = genWidth;
+        } else if (strcmp(argv[i], "--gen-seed") == 0 && i + 1 < argc) {
+            genSeed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--gen-threads") == 0 && i + 1 < argc) {
+            genThreads = std::max(0, atoi(argv[++i]));
+        }
+    }
+    if (streamPath) {
+        double t0 = now();
+        if (startStreaming(streamPath, streamBudget)) printf("Stream started in %.3f ms\n", (now() - t0) * 1000.0);
+    } else if (mapPath) {
+        // 读取失败时退回内置地图
+        double t0 = now();
+        if (mapLoad(mapPath, mapData, mapOptions)) printf("Map loaded in %.3f ms\n", (now() - t0) * 1000.0);
+    } else if (endlessWidth > 0) {
+        double t0 = now();
+        if (startEndless(endlessWidth, genSeed)) printf("Endless maze started in %.3f ms\n", (now() - t0) * 1000.0);
+    } else if (infiniteMaze) {
+        double t0 = now();
+        startInfinite(genSeed);
+        printf("Infinite maze started in %.3f ms\n", (now() - t0) * 1000.0);
+    }
+
     initGame();
+    atexit(shutdownGame);
+
+    // 命令行参数：--map <file> [--map-populate] [--map-huge-pages]  --save-map <file>
+    //          --stream <file> [--stream-budget <MB>]  --save-stream <file>
+    //          --gen <backtracker|kruskal|wilson|prim> [--gen-size <n|WxH>] [--gen-seed <n>] [--gen-threads <n>]
+    //          --endless <width>  --infinite  --analysis  --no-analysis
+    //          --record <file|"|command">  --trace <file>  --perf  --no-impostor  --no-lod  --no-occlusion  --stats-dump <file>  --profile  --row-major  --headless <frames>
+    //          --bench <script> [--bench-dt <seconds>]  --record-input <file>  --replay <file>
+    //          --bench-suite <out.csv|out.json> [--bench-density <0..1>] [--bench-seed <n>]  --tiled
+    int headlessFrames = 0;
+    const char* suitePath = NULL;
+    float suiteDensity = 0.5f;
+    uint64_t suiteSeed = 1;
+    const char* benchScript = NULL;
+    const char* replayPath = NULL;
+    float benchDt = 1.0f / 60.0f;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+            startRecording();
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            i++;
+        } else if ((strcmp(argv[i], "--map") == 0 || strcmp(argv[i], "--stream") == 0 ||
+                    strcmp(argv[i], "--stream-budget") == 0 || strcmp(argv[i], "--gen") == 0 ||
+                    strcmp(argv[i], "--endless") == 0 || strcmp(argv[i], "--gen-size") == 0 || strcmp(argv[i], "--gen-seed") == 0 ||
+                    strcmp(argv[i], "--gen-threads") == 0) && i + 1 < argc) {
+            i++;    // 已经在 initGame() 之前处理
+        } else if (strcmp(argv[i], "--save-map") == 0 && i + 1 < argc) {
+            mapSave(argv[++i], mapData);
+        } else if (strcmp(argv[i], "--save-stream") == 0 && i + 1 < argc) {
+            mapStreamSave(argv[++i], mapData);
+        } else if (strcmp(argv[i], "--perf") == 0 || strcmp(argv[i], "--map-populate") == 0 ||
+                   strcmp(argv[i], "--map-huge-pages") == 0 || strcmp(argv[i], "--infinite") == 0 ||
+                   strcmp(argv[i], "--analysis") == 0 || strcmp(argv[i], "--no-analysis") == 0) {
+            // 已经在 initGame() 之前处理
+        } else if (strcmp(argv[i], "--no-impostor") == 0) {
+            useImpostor = false;
+        } else if (strcmp(argv[i], "--no-lod") == 0) {
+            lodEnabled = false;
+        } else if (strcmp(argv[i], "--no-occlusion") == 0) {
+            occlusionEnabled = false;
+        } else if (strcmp(argv[i], "--stats-dump") == 0 && i + 1 < argc) {
+            statOpenDump(argv[++i]);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profileSetEnabled(true);
+        } else if (strcmp(argv[i], "--tiled") == 0) {
+            if (streaming || endless || infinite) printf("--tiled is ignored for streamed, endless and infinite maps\n");
+            else mapData.setTiled(true);
+        } else if (strcmp(argv[i], "--row-major") == 0) {
+            frontToBack = false;
+        } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchScript = argv[++i];
+        } else if (strcmp(argv[i], "--bench-dt") == 0 && i + 1 < argc) {
+            benchDt = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-suite") == 0 && i + 1 < argc) {
+            suitePath = argv[++i];
+        } else if (strcmp(argv[i], "--bench-density") == 0 && i + 1 < argc) {
+            suiteDensity = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-seed") == 0 && i + 1 < argc) {
+            suiteSeed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--record-input") == 0 && i + 1 < argc) {
+            startInputLog(argv[++i]);
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+    }
+
+    if (headlessFrames > 0 || benchScript || replayPath || suitePath) {
+        if (suitePath) runBenchSuite(suitePath, suiteDensity, suiteSeed);
+        else if (replayPath) runReplay(replayPath);
+        else if (benchScript) runBenchmark(benchScript, benchDt);
+        else runHeadless(headlessFrames);
+        // 录像要在 GL 上下文还在时取回最后一帧；其余的收尾交给 atexit 注册的 shutdownGame()，只做一次
+        stopRecording();
+        return 0;
+    }
 
     glutDisplayFunc(display);
     glutIdleFunc(idle);
@@ -0,0 +1,414 @@
+#pragma once
+// 地图文件的读写。几种格式，读取时按文件开头的魔数和版本自动区分：
+//
+// 文本格式：每行一排格子，所有行一样长，空行忽略。
+//   '#' 或 '1' 墙，'.'、' ' 或 '0' 空地，'S' 或 '2' 起点，'E' 或 '3' 终点
+//
+// 二进制格式（小端），文件头 16 字节：
+//   "MAZB"  u16 版本  u16 标志  u32 宽  u32 高
+// 第 1 版：文件头后面紧跟按行存放的格子，和 MapBlocks 一样每格 2 位、每个 u64 存 32 格、每行从新的 u64 开始。
+//   读的时候整块 fread 进 mapData.blocks.words，只能读不再写。
+// 第 2 版：文件头后面是 u32 段数、u32 保留，再跟段表，每段 {u32 类型, u32 保留, u64 偏移, u64 字节数}。
+//   每段从 4096 字节对齐的位置开始，内容和内存里的结构逐字节一致：
+//     CELLS   格子（必需），即 MapBlocks.words；标志里有 MAP_FILE_TILED 时按 8x8 块存放
+//     WALLS   墙位图（可选，预先算好），即 MapBlocks.walls
+//     MARKERS 起点和终点（可选，预先算好），每个 {i32 i, i32 j, i32 类型}
+//   不认识的段直接跳过。读的时候把整个文件 mmap 进来，格子和墙位图直接用映射的内存，
+//   不解析也不拷贝，启动时间只取决于缺页；映射是私有的，游戏里改地图不会写回文件。
+//
+// 所有格式都要求恰好一个起点、至少一个终点；出错时打印原因并返回 false，地图保持不变。
+#include "define.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MAP_FILE_VERSION 2
+#define MAP_FILE_HEADER_SIZE 16
+#define MAP_FILE_ALIGN 4096
+#define MAP_FILE_TILED 1
+#define MAP_SECTION_CELLS   1
+#define MAP_SECTION_WALLS   2
+#define MAP_SECTION_MARKERS 3
+#define MAP_TEXT_BUFFER (1 << 16)
+
+struct MapFileHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t flags;
+    uint32_t width;
+    uint32_t height;
+};
+static_assert(sizeof(MapFileHeader) == MAP_FILE_HEADER_SIZE, "map file header must be 16 bytes");
+
+struct MapFileSection {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+static_assert(sizeof(MapFileSection) == 24, "map file section entry must be 24 bytes");
+static_assert(sizeof(MapMarker) == 12, "markers are stored as three 32-bit ints");
+
+// 第 2 版文件的映射方式。populate 让 mmap 一次把整个文件读进来，省掉之后零散的缺页；
+// hugePages 只是向内核建议使用大页，文件映射能不能用上取决于内核和文件系统。
+struct MapLoadOptions {
+    bool populate = false;
+    bool hugePages = false;
+};
+
+inline bool mapValidateMarkers(const Map& map, const char* path) {
+    int starts = 0, ends = 0;
+    for (size_t k = 0; k < map.blocks.markers.size(); k++) {
+        if (map.blocks.markers[k].type == MAP_BLOCK_START) starts++;
+        else ends++;
+    }
+    if (starts != 1 || ends < 1) {
+        printf("Map %s: need exactly one start and at least one end (found %d and %d)\n", path, starts, ends);
+        return false;
+    }
+    return true;
+}
+
+inline int mapTextCell(int c) {
+    switch (c) {
+        case '#': case '1': return MAP_BLOCK_CUBE;
+        case '.': case ' ': case '0': return MAP_BLOCK_EMPTY;
+        case 'S': case '2': return MAP_BLOCK_START;
+        case 'E': case '3': return MAP_BLOCK_END;
+        default: return -1;
+    }
+}
+
+// 分块读入、逐字符解析，每格先存成一个字节，读完知道高度之后再打包
+inline bool mapLoadText(FILE* f, const char* path, Map& out) {
+    std::vector<unsigned char> cells;
+    std::vector<char> buf(MAP_TEXT_BUFFER);
+    long long width = -1, col = 0, line = 1, rows = 0;
+    bool ok = true;
+    auto endRow = [&]() {
+        if (col == 0) return true;          // 空行
+        if (width < 0) width = col;
+        if (col != width || width > MAP_MAX) {
+            printf("Map %s:%lld: row has %lld cells, expected %lld\n", path, line, col, width);
+            return false;
+        }
+        rows++;
+        col = 0;
+        return true;
+    };
+    size_t n;
+    while (ok && (n = fread(buf.data(), 1, buf.size(), f)) > 0) {
+        for (size_t k = 0; k < n && ok; k++) {
+            char c = buf[k];
+            if (c == '\r') continue;
+            if (c == '\n') {
+                ok = endRow();
+                line++;
+                continue;
+            }
+            int v = mapTextCell(c);
+            if (v < 0) {
+                printf("Map %s:%lld: unexpected character '%c'\n", path, line, c);
+                ok = false;
+                break;
+            }
+            cells.push_back((unsigned char)v);
+            col++;
+        }
+    }
+    if (ok) ok = endRow();
+    if (!ok) return false;
+    if (rows == 0 || rows > MAP_MAX) {
+        printf("Map %s: bad height %lld\n", path, rows);
+        return false;
+    }
+
+    Map map;
+    map.resize((GLint)width, (GLint)rows);
+    for (long long i = 0; i < rows; i++) {
+        uint64_t* row = &map.blocks.words[i * map.blocks.stride];
+        const unsigned char* src = &cells[i * width];
+        for (long long j = 0; j < width; j++)
+            row[j / MAP_CELLS_PER_WORD] |= (uint64_t)src[j] << (j % MAP_CELLS_PER_WORD * MAP_CELL_BITS);
+    }
+    map.rebuildIndex();
+    if (!mapValidateMarkers(map, path)) return false;
+    out = std::move(map);
+    return true;
+}
+
+inline bool mapLoadBinary(FILE* f, const char* path, Map& out) {
+    MapFileHeader h;
+    if (fread(&h, 1, sizeof(h), f) != sizeof(h) || memcmp(h.magic, "MAZB", 4) != 0) {
+        printf("Map %s: bad header\n", path);
+        return false;
+    }
+    if (h.version != 1) {
+        printf("Map %s: unsupported version %u\n", path, (unsigned)h.version);
+        return false;
+    }
+    if (h.width == 0 || h.height == 0 || h.width > MAP_MAX || h.height > MAP_MAX) {
+        printf("Map %s: bad size %u x %u\n", path, h.width, h.height);
+        return false;
+    }
+
+    Map map;
+    map.resize((GLint)h.width, (GLint)h.height);
+    size_t words = map.blocks.words.size();
+    if (fread(map.blocks.words.data(), sizeof(uint64_t), words, f) != words) {
+        printf("Map %s: file is truncated\n", path);
+        return false;
+    }
+    // 行尾多出来的格子不属于地图，清零
+    if (h.width % MAP_CELLS_PER_WORD) {
+        uint64_t mask = (1ull << (h.width % MAP_CELLS_PER_WORD * MAP_CELL_BITS)) - 1;
+        for (uint32_t i = 0; i < h.height; i++)
+            map.blocks.words[(i + 1) * map.blocks.stride - 1] &= mask;
+    }
+    map.rebuildIndex();
+    if (!mapValidateMarkers(map, path)) return false;
+    out = std::move(map);
+    return true;
+}
+
+// 整个文件映射成可写的私有内存；没有 mmap 的平台退回到读进一块堆内存。
+// 返回的 shared_ptr 在最后一个引用释放时解除映射。
+inline std::shared_ptr<void> mapFileBytes(const char* path, size_t& size, const MapLoadOptions& opt) {
+#ifdef _WIN32
+    (void)opt;
+    FILE* f = fopen(path, "rb");
+    if (!f) return nullptr;
+    fseek(f, 0, SEEK_END);
+    size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    auto buf = std::make_shared<std::vector<uint64_t>>((size + 7) / 8);
+    bool ok = fread(buf->data(), 1, size, f) == size;
+    fclose(f);
+    if (!ok) return nullptr;
+    return std::shared_ptr<void>(buf, buf->data());
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < MAP_FILE_HEADER_SIZE) {
+        close(fd);
+        return nullptr;
+    }
+    size = (size_t)st.st_size;
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (opt.populate) flags |= MAP_POPULATE;
+#endif
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return nullptr;
+#ifndef MAP_POPULATE
+    if (opt.populate) madvise(p, size, MADV_WILLNEED);
+#endif
+#ifdef MADV_HUGEPAGE
+    if (opt.hugePages) madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return std::shared_ptr<void>(p, [size](void* q) { munmap(q, size); });
+#endif
+}
+
+inline bool mapLoadMapped(const char* path, Map& out, const MapLoadOptions& opt) {
+    size_t size = 0;
+    std::shared_ptr<void> file = mapFileBytes(path, size, opt);
+    if (!file) {
+        printf("Map %s: cannot map file\n", path);
+        return false;
+    }
+    unsigned char* base = (unsigned char*)file.get();
+    MapFileHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (h.width == 0 || h.height == 0 || h.width > MAP_MAX || h.height > MAP_MAX) {
+        printf("Map %s: bad size %u x %u\n", path, h.width, h.height);
+        return false;
+    }
+    uint32_t sections = 0;
+    if (size >= MAP_FILE_HEADER_SIZE + 8) memcpy(&sections, base + MAP_FILE_HEADER_SIZE, 4);
+    if (sections > (size - MAP_FILE_HEADER_SIZE - 8) / sizeof(MapFileSection)) {
+        printf("Map %s: bad section table\n", path);
+        return false;
+    }
+
+    // 按文件里的存放方式算出各段应有的大小，再把格子和墙位图直接指向映射的内存
+    Map map;
+    map.blocks.tiled = (h.flags & MAP_FILE_TILED) != 0;
+    size_t expected[2] = { map.setShape((GLint)h.width, (GLint)h.height), map.blocks.wallStride * h.height };
+    bool hasCells = false, hasWalls = false, hasMarkers = false;
+    std::vector<MapMarker> markers;
+    for (uint32_t k = 0; k < sections; k++) {
+        MapFileSection sec;
+        memcpy(&sec, base + MAP_FILE_HEADER_SIZE + 8 + k * sizeof(sec), sizeof(sec));
+        if (sec.offset % 8 != 0 || sec.offset > size || sec.size > size - sec.offset) {
+            printf("Map %s: section %u lies outside the file\n", path, k);
+            return false;
+        }
+        if (sec.type == MAP_SECTION_CELLS || sec.type == MAP_SECTION_WALLS) {
+            int w = sec.type == MAP_SECTION_CELLS ? 0 : 1;
+            if (sec.size != expected[w] * sizeof(uint64_t)) {
+                printf("Map %s: section %u has %llu bytes, expected %llu\n", path, k,
+                       (unsigned long long)sec.size, (unsigned long long)(expected[w] * sizeof(uint64_t)));
+                return false;
+            }
+            (w == 0 ? map.blocks.words : map.blocks.walls).borrow((uint64_t*)(base + sec.offset), expected[w], file);
+            (w == 0 ? hasCells : hasWalls) = true;
+        } else if (sec.type == MAP_SECTION_MARKERS) {
+            if (sec.size % sizeof(MapMarker) != 0) {
+                printf("Map %s: bad marker section\n", path);
+                return false;
+            }
+            markers.resize(sec.size / sizeof(MapMarker));
+            memcpy(markers.data(), base + sec.offset, sec.size);
+            for (size_t m = 0; m < markers.size(); m++) {
+                const MapMarker& mk = markers[m];
+                if (mk.i < 0 || mk.j < 0 || mk.i >= (GLint)h.height || mk.j >= (GLint)h.width ||
+                    (mk.type != MAP_BLOCK_START && mk.type != MAP_BLOCK_END)) {
+                    printf("Map %s: bad marker %d at (%d, %d)\n", path, mk.type, mk.i, mk.j);
+                    return false;
+                }
+            }
+            hasMarkers = true;
+        }
+    }
+    if (!hasCells) {
+        printf("Map %s: no cell section\n", path);
+        return false;
+    }
+    if (hasWalls && hasMarkers) {
+        // 预先算好的段不逐格核对（那样就失去映射的意义了），只查标记所在的格子和每行末尾的填充位
+        for (size_t m = 0; m < markers.size(); m++) {
+            const MapMarker& mk = markers[m];
+            if (map.blocks.get(mk.i, mk.j) != mk.type) {
+                printf("Map %s: marker %d at (%d, %d) does not match its cell\n", path, mk.type, mk.i, mk.j);
+                return false;
+            }
+        }
+        if (h.width % 64) {
+            uint64_t pad = ~((1ull << (h.width % 64)) - 1);
+            for (uint32_t i = 0; i < h.height; i++) {
+                if (map.blocks.walls[(i + 1) * map.blocks.wallStride - 1] & pad) {
+                    printf("Map %s: wall bitmap row %u has bits past the map width\n", path, i);
+                    return false;
+                }
+            }
+        }
+        map.blocks.markers = markers;
+    } else {
+        // 没有预先算好的索引，从格子重建（墙位图放在自己的内存里）
+        map.blocks.walls.assign(expected[1], 0);
+        map.rebuildIndex();
+    }
+    if (!mapValidateMarkers(map, path)) return false;
+    out = std::move(map);
+    return true;
+}
+
+// 文本和第 1 版二进制读入后沿用 out 原来的存放方式（按行或 8x8 块）；
+// 第 2 版二进制沿用文件里的存放方式，这样才能直接使用映射的内存。
+inline bool mapLoad(const char* path, Map& out, const MapLoadOptions& opt = MapLoadOptions()) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Map: cannot open %s\n", path);
+        return false;
+    }
+    MapFileHeader h;
+    memset(&h, 0, sizeof(h));
+    size_t got = fread(&h, 1, sizeof(h), f);
+    fseek(f, 0, SEEK_SET);
+    bool binary = got >= 6 && memcmp(h.magic, "MAZB", 4) == 0;
+    if (binary && h.version == MAP_FILE_VERSION) {
+        fclose(f);
+        if (!mapLoadMapped(path, out, opt)) return false;
+        printf("Loaded map %s (%d x %d, %s, %s)\n", path, out.width, out.height,
+               out.blocks.tiled ? "tiled" : "row-major", out.blocks.words.borrowed() ? "mapped" : "copied");
+        return true;
+    }
+    bool tiled = out.blocks.tiled;
+    Map map;
+    bool ok = binary ? mapLoadBinary(f, path, map) : mapLoadText(f, path, map);
+    fclose(f);
+    if (!ok) return false;
+    map.setTiled(tiled);
+    out = std::move(map);
+    printf("Loaded map %s (%d x %d)\n", path, out.width, out.height);
+    return true;
+}
+
+inline bool mapWritePadding(FILE* f, uint64_t& pos, uint64_t to) {
+    static const char ZEROS[MAP_FILE_ALIGN] = {};
+    size_t n = (size_t)(to - pos);
+    pos = to;
+    return fwrite(ZEROS, 1, n, f) == n;
+}
+
+inline uint64_t mapAlign(uint64_t pos) { return (pos + MAP_FILE_ALIGN - 1) / MAP_FILE_ALIGN * MAP_FILE_ALIGN; }
+
+// 第 2 版：格子、墙位图和起点/终点表各占一段，按当前的存放方式原样写出
+inline bool mapWriteBinary(FILE* f, const Map& in) {
+    MapFileHeader h;
+    memcpy(h.magic, "MAZB", 4);
+    h.version = MAP_FILE_VERSION;
+    h.flags = in.blocks.tiled ? MAP_FILE_TILED : 0;
+    h.width = (uint32_t)in.width;
+    h.height = (uint32_t)in.height;
+    uint32_t count[2] = { 3, 0 };
+    MapFileSection sec[3];
+    const void* data[3] = { in.blocks.words.data(), in.blocks.walls.data(), in.blocks.markers.data() };
+    uint64_t bytes[3] = { in.blocks.words.size() * sizeof(uint64_t), in.blocks.walls.size() * sizeof(uint64_t),
+                          in.blocks.markers.size() * sizeof(MapMarker) };
+    uint32_t types[3] = { MAP_SECTION_CELLS, MAP_SECTION_WALLS, MAP_SECTION_MARKERS };
+    uint64_t pos = MAP_FILE_HEADER_SIZE + sizeof(count) + sizeof(sec);
+    for (int k = 0; k < 3; k++) {
+        pos = mapAlign(pos);
+        sec[k].type = types[k];
+        sec[k].reserved = 0;
+        sec[k].offset = pos;
+        sec[k].size = bytes[k];
+        pos += bytes[k];
+    }
+    pos = MAP_FILE_HEADER_SIZE + sizeof(count) + sizeof(sec);
+    bool ok = fwrite(&h, 1, sizeof(h), f) == sizeof(h) && fwrite(count, 1, sizeof(count), f) == sizeof(count) &&
+              fwrite(sec, 1, sizeof(sec), f) == sizeof(sec);
+    for (int k = 0; k < 3 && ok; k++) {
+        ok = mapWritePadding(f, pos, sec[k].offset) && fwrite(data[k], 1, (size_t)bytes[k], f) == bytes[k];
+        pos += bytes[k];
+    }
+    return ok;
+}
+
+// 扩展名是 .txt 时写文本，否则写二进制
+inline bool mapSave(const char* path, const Map& in) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Map: cannot open %s\n", path);
+        return false;
+    }
+    size_t len = strlen(path);
+    bool text = len >= 4 && strcmp(path + len - 4, ".txt") == 0;
+    bool ok = true;
+    if (text) {
+        static const char CHARS[4] = { '.', '#', 'S', 'E' };
+        std::vector<char> line(in.width + 1);
+        line[in.width] = '\n';
+        for (GLint i = 0; i < in.height && ok; i++) {
+            for (GLint j = 0; j < in.width; j++) line[j] = CHARS[in.blocks.get(i, j)];
+            ok = fwrite(line.data(), 1, line.size(), f) == line.size();
+        }
+    } else {
+        ok = mapWriteBinary(f, in);
+    }
+    if (fclose(f) != 0) ok = false;
+    if (!ok) printf("Map: failed to write %s\n", path);
+    else printf("Saved map %s (%d x %d)\n", path, in.width, in.height);
+    return ok;
+}
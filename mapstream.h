@@ -0,0 +1,476 @@
+#pragma once
+// 分块流式加载的大地图：地图在磁盘上切成 64x64 的块，内存里只保留玩家附近的块。
+//
+// 读块在后台线程里做，主线程只发请求、只读已经到达的块，从不等待磁盘。
+// 每帧按窗口重新排请求：窗口里的块按离玩家的距离由近到远最先，然后是朝向前方的一条；
+// 常驻块的总数受内存预算限制，超出时换掉最久没用到的块（LRU）。
+//
+// 磁盘格式（小端）：
+//   "MAZS"  u16 版本  u16 块边长  u32 宽  u32 高  u32 标记数  u32 保留
+//   然后是起点和终点表，每个 {i32 i, i32 j, i32 类型}
+//   从 4096 字节对齐的位置开始存放各块，按块的行优先顺序。每块 64 行，每行 2 个 u64，
+//   格子的编码和 MapBlocks 按行存放时一样，地图边界外的格子为 0。
+// 第 1 版每块原样存放，偏移可以直接算出来。
+// 第 2 版每块单独压缩（见 chunkrle.h），块之前是 (块数 + 1) 个 u64 的偏移表（从文件开头算），
+// 第 k 块占 [偏移[k], 偏移[k+1])。压缩后的块第一个字节是存放方式：
+//   0 原样  1 格子和上一行异或后游程编码
+//   2、3 只有墙位图，和上一行 / 上面第二行异或后游程编码（块里没有起点和终点时才用）
+#include "define.h"
+#include "trace.h"
+#include "chunkrle.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define STREAM_FILE_VERSION 2
+#define STREAM_HEADER_SIZE 24
+#define STREAM_ALIGN 4096
+#define STREAM_CHUNK 64                                     // 块边长，正好是墙位图的一个字
+#define STREAM_CHUNK_WORDS (STREAM_CHUNK / MAP_CELLS_PER_WORD)
+#define STREAM_CHUNK_BYTES (STREAM_CHUNK * STREAM_CHUNK_WORDS * 8)
+#define STREAM_SLOT_BYTES (STREAM_CHUNK_BYTES + STREAM_CHUNK * 8)
+#define STREAM_RADIUS 3                                     // 玩家所在块周围保留几圈
+#define STREAM_WINDOW (2 * STREAM_RADIUS + 1)
+#define STREAM_PREFETCH 4                                   // 朝向前方再多预取几块
+#define STREAM_DEFAULT_BUDGET_MB 64
+
+#define STREAM_CHUNK_RAW   0
+#define STREAM_CHUNK_CELLS 1
+#define STREAM_CHUNK_WALLS 2
+#define STREAM_CHUNK_WALLS2 3
+
+#define STREAM_ABSENT   0
+#define STREAM_QUEUED   1
+#define STREAM_LOADING  2
+#define STREAM_RESIDENT 3
+
+struct StreamFileHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t chunkSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t markerCount;
+    uint32_t reserved;
+};
+static_assert(sizeof(StreamFileHeader) == STREAM_HEADER_SIZE, "stream file header must be 24 bytes");
+
+struct StreamSlot {
+    uint64_t cells[STREAM_CHUNK * STREAM_CHUNK_WORDS];
+    uint64_t walls[STREAM_CHUNK];
+    int chunk = -1;
+    uint64_t lastUsed = 0;
+};
+
+struct MapStream {
+    FILE* file = NULL;              // 只有后台线程使用
+    int width = 0, height = 0;
+    int chunksX = 0, chunksY = 0;
+    int version = 0;
+    uint64_t dataOffset = 0;
+    std::vector<uint64_t> index;    // 第 2 版的块偏移表
+    std::vector<MapMarker> markers; // 整张地图的坐标
+
+    // 以下只由主线程读写
+    std::vector<StreamSlot> slots;
+    std::vector<int> freeSlots;
+    std::vector<int> chunkSlot;     // 块 -> 槽，-1 表示没有槽
+    uint64_t clock = 0;
+    unsigned evictions = 0, requests = 0;
+
+    // 主线程和后台线程共享
+    std::unique_ptr<std::atomic<uint8_t>[]> state;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<int> queue;          // 受 lock 保护，队首最先读
+    bool quit = false;
+    std::atomic<unsigned> loads{0};
+    std::atomic<unsigned long long> bytesRead{0};
+    std::thread io;
+};
+
+// 压缩一块，追加到 out 后面：三种存放方式都试一遍，取最短的
+inline size_t mapStreamCompressChunk(const uint64_t* cells, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> best, trial;
+    best.push_back(STREAM_CHUNK_RAW);
+    best.insert(best.end(), (const uint8_t*)cells, (const uint8_t*)cells + STREAM_CHUNK_BYTES);
+
+    trial.push_back(STREAM_CHUNK_CELLS);
+    rleCompressRows(cells, STREAM_CHUNK, STREAM_CHUNK_WORDS, 1, trial);
+    if (trial.size() < best.size()) best.swap(trial);
+
+    // 没有起点和终点（格子的高位全为 0）时格子完全由墙位图决定
+    const uint64_t odd = 0xAAAAAAAAAAAAAAAAull;
+    uint64_t markers = 0, walls[STREAM_CHUNK];
+    for (int r = 0; r < STREAM_CHUNK; r++) {
+        walls[r] = 0;
+        for (int w = 0; w < STREAM_CHUNK_WORDS; w++) {
+            uint64_t v = cells[r * STREAM_CHUNK_WORDS + w];
+            markers |= v & odd;
+            walls[r] |= mapCompactEvenBits(v) << (w * MAP_CELLS_PER_WORD);
+        }
+    }
+    for (int period = 1; period <= 2 && !markers; period++) {
+        trial.clear();
+        trial.push_back(period == 1 ? STREAM_CHUNK_WALLS : STREAM_CHUNK_WALLS2);
+        rleCompressRows(walls, STREAM_CHUNK, 1, period, trial);
+        if (trial.size() < best.size()) best.swap(trial);
+    }
+    out.insert(out.end(), best.begin(), best.end());
+    return best.size();
+}
+
+inline bool mapStreamDecompressChunk(const uint8_t* src, size_t size, uint64_t* cells) {
+    if (size == 0) return false;
+    switch (src[0]) {
+        case STREAM_CHUNK_RAW:
+            if (size != 1 + STREAM_CHUNK_BYTES) return false;
+            memcpy(cells, src + 1, STREAM_CHUNK_BYTES);
+            return true;
+        case STREAM_CHUNK_CELLS:
+            return rleDecompressRows(src + 1, size - 1, cells, STREAM_CHUNK, STREAM_CHUNK_WORDS, 1);
+        case STREAM_CHUNK_WALLS:
+        case STREAM_CHUNK_WALLS2: {
+            uint64_t walls[STREAM_CHUNK];
+            if (!rleDecompressRows(src + 1, size - 1, walls, STREAM_CHUNK, 1, src[0] == STREAM_CHUNK_WALLS ? 1 : 2))
+                return false;
+            for (int r = 0; r < STREAM_CHUNK; r++)
+                for (int w = 0; w < STREAM_CHUNK_WORDS; w++)
+                    cells[r * STREAM_CHUNK_WORDS + w] = mapSpreadEvenBits(walls[r] >> (w * MAP_CELLS_PER_WORD));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+inline bool mapStreamSeek(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// buf 是后台线程自己的缓冲区，放压缩后的数据
+inline bool mapStreamReadChunk(MapStream& s, int k, uint64_t* cells, std::vector<uint8_t>& buf) {
+    TRACE_SCOPE("readChunk");
+    if (s.version == 1) {
+        s.bytesRead.fetch_add(STREAM_CHUNK_BYTES, std::memory_order_relaxed);
+        return mapStreamSeek(s.file, s.dataOffset + (uint64_t)k * STREAM_CHUNK_BYTES) &&
+               fread(cells, 1, STREAM_CHUNK_BYTES, s.file) == STREAM_CHUNK_BYTES;
+    }
+    uint64_t begin = s.index[k], end = s.index[k + 1];
+    if (end < begin || end - begin > 2 * STREAM_CHUNK_BYTES) return false;
+    buf.resize((size_t)(end - begin));
+    s.bytesRead.fetch_add(buf.size(), std::memory_order_relaxed);
+    if (!mapStreamSeek(s.file, begin) || fread(buf.data(), 1, buf.size(), s.file) != buf.size()) return false;
+    TRACE_SCOPE("decompressChunk");
+    return mapStreamDecompressChunk(buf.data(), buf.size(), cells);
+}
+
+// 每行的墙位图：低位为 1、高位为 0 的格子是墙（和 Map::rebuildIndex 一样）
+inline void mapStreamBuildWalls(StreamSlot& slot) {
+    const uint64_t even = 0x5555555555555555ull;
+    for (int r = 0; r < STREAM_CHUNK; r++) {
+        uint64_t bits = 0;
+        for (int w = 0; w < STREAM_CHUNK_WORDS; w++) {
+            uint64_t v = slot.cells[r * STREAM_CHUNK_WORDS + w];
+            bits |= mapCompactEvenBits(v & ~(v >> 1) & even) << (w * MAP_CELLS_PER_WORD);
+        }
+        slot.walls[r] = bits;
+    }
+}
+
+inline void mapStreamWorker(MapStream* s) {
+    traceSetThreadName("mapStream");
+    std::vector<uint8_t> buf;
+    for (;;) {
+        int k;
+        StreamSlot* slot;
+        {
+            std::unique_lock<std::mutex> guard(s->lock);
+            s->wake.wait(guard, [s] { return s->quit || !s->queue.empty(); });
+            if (s->quit) return;
+            k = s->queue.front();
+            s->queue.pop_front();
+            // 拿到 LOADING 之后主线程不会再动这个槽
+            s->state[k].store(STREAM_LOADING, std::memory_order_relaxed);
+            slot = &s->slots[s->chunkSlot[k]];
+        }
+        if (!mapStreamReadChunk(*s, k, slot->cells, buf)) {
+            // 读失败的块当作整块墙，玩家走不进去
+            printf("Stream: failed to read chunk %d\n", k);
+            for (int w = 0; w < STREAM_CHUNK * STREAM_CHUNK_WORDS; w++) slot->cells[w] = 0x5555555555555555ull;
+        }
+        mapStreamBuildWalls(*slot);
+        s->state[k].store(STREAM_RESIDENT, std::memory_order_release);
+        s->loads.fetch_add(1, std::memory_order_release);   // 主线程看到计数变化时块一定已经可读
+    }
+}
+
+inline bool mapStreamOpen(MapStream& s, const char* path, int budgetMB) {
+    if (budgetMB <= 0) {
+        printf("Stream: budget must be a positive number of MB\n");
+        return false;
+    }
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Stream: cannot open %s\n", path);
+        return false;
+    }
+    StreamFileHeader h;
+    if (fread(&h, 1, sizeof(h), f) != sizeof(h) || memcmp(h.magic, "MAZS", 4) != 0 ||
+        (h.version != 1 && h.version != STREAM_FILE_VERSION) || h.chunkSize != STREAM_CHUNK) {
+        printf("Stream %s: not a chunked map this version can read\n", path);
+        fclose(f);
+        return false;
+    }
+    if (h.width == 0 || h.height == 0 || h.width > MAP_MAX || h.height > MAP_MAX || h.markerCount > (1u << 20)) {
+        printf("Stream %s: bad header\n", path);
+        fclose(f);
+        return false;
+    }
+    s.markers.resize(h.markerCount);
+    if (fread(s.markers.data(), sizeof(MapMarker), h.markerCount, f) != h.markerCount) {
+        printf("Stream %s: file is truncated\n", path);
+        fclose(f);
+        return false;
+    }
+    // 标记表和 mapValidateMarkers 一样检查：类型、范围，恰好一个起点、至少一个终点
+    int starts = 0, ends = 0;
+    for (size_t k = 0; k < s.markers.size(); k++) {
+        const MapMarker& mk = s.markers[k];
+        if (mk.i < 0 || mk.j < 0 || mk.i >= (GLint)h.height || mk.j >= (GLint)h.width ||
+            (mk.type != MAP_BLOCK_START && mk.type != MAP_BLOCK_END)) {
+            printf("Stream %s: bad marker %d at (%d, %d)\n", path, mk.type, mk.i, mk.j);
+            fclose(f);
+            return false;
+        }
+        (mk.type == MAP_BLOCK_START ? starts : ends)++;
+    }
+    if (starts != 1 || ends < 1) {
+        printf("Stream %s: need exactly one start and at least one end (found %d and %d)\n", path, starts, ends);
+        fclose(f);
+        return false;
+    }
+    s.width = (int)h.width;
+    s.height = (int)h.height;
+    s.chunksX = (s.width + STREAM_CHUNK - 1) / STREAM_CHUNK;
+    s.chunksY = (s.height + STREAM_CHUNK - 1) / STREAM_CHUNK;
+    s.version = h.version;
+    uint64_t tableEnd = STREAM_HEADER_SIZE + (uint64_t)h.markerCount * sizeof(MapMarker);
+    s.dataOffset = (tableEnd + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+    if (s.version >= 2) {
+        size_t entries = (size_t)s.chunksX * s.chunksY + 1;
+        s.index.resize(entries);
+        if (!mapStreamSeek(f, s.dataOffset) || fread(s.index.data(), sizeof(uint64_t), entries, f) != entries) {
+            printf("Stream %s: chunk index is truncated\n", path);
+            fclose(f);
+            return false;
+        }
+    }
+    s.file = f;
+
+    // 预算至少要放得下窗口和前方的预取
+    size_t want = STREAM_WINDOW * (STREAM_WINDOW + STREAM_PREFETCH);
+    size_t count = std::max(want, (size_t)budgetMB * 1024 * 1024 / STREAM_SLOT_BYTES);
+    count = std::min(count, (size_t)s.chunksX * s.chunksY);
+    s.slots.resize(count);
+    s.freeSlots.clear();
+    for (size_t k = count; k-- > 0; ) s.freeSlots.push_back((int)k);
+    size_t chunks = (size_t)s.chunksX * s.chunksY;
+    s.chunkSlot.assign(chunks, -1);
+    s.state.reset(new std::atomic<uint8_t>[chunks]);
+    for (size_t k = 0; k < chunks; k++) s.state[k].store(STREAM_ABSENT, std::memory_order_relaxed);
+    s.quit = false;
+    s.io = std::thread(mapStreamWorker, &s);
+    printf("Streaming map %s (%d x %d, %d x %d chunks, version %d, %zu resident at most, %.1f MB)\n", path,
+           s.width, s.height, s.chunksX, s.chunksY, s.version, count, count * (double)STREAM_SLOT_BYTES / (1024 * 1024));
+    return true;
+}
+
+inline void mapStreamClose(MapStream& s) {
+    if (!s.file) return;
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.quit = true;
+    }
+    s.wake.notify_one();
+    s.io.join();
+    fclose(s.file);
+    s.file = NULL;
+    printf("Stream: %u chunks loaded (%.1f MB read), %u requests, %u evictions\n",
+           s.loads.load(), s.bytesRead.load() / (1024.0 * 1024.0), s.requests, s.evictions);
+}
+
+inline bool mapStreamResident(const MapStream& s, int k) {
+    return s.state[k].load(std::memory_order_acquire) == STREAM_RESIDENT;
+}
+
+// 只在块已经到达时返回它的槽
+inline const StreamSlot* mapStreamChunk(const MapStream& s, int cy, int cx) {
+    int k = cy * s.chunksX + cx;
+    return mapStreamResident(s, k) ? &s.slots[s.chunkSlot[k]] : NULL;
+}
+
+// 只在启动时使用：等某一块到达，最多等 timeoutMs 毫秒
+inline bool mapStreamWait(const MapStream& s, int cy, int cx, int timeoutMs) {
+    for (int t = 0; t < timeoutMs && !mapStreamChunk(s, cy, cx); t++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return mapStreamChunk(s, cy, cx) != NULL;
+}
+
+// 给块分一个槽：先用空槽，没有就换掉最久没用到的常驻块。已在队列里或正在读的块不会被换掉。
+inline int mapStreamTakeSlot(MapStream& s) {
+    if (!s.freeSlots.empty()) {
+        int slot = s.freeSlots.back();
+        s.freeSlots.pop_back();
+        return slot;
+    }
+    int victim = -1;
+    for (size_t k = 0; k < s.slots.size(); k++) {
+        int c = s.slots[k].chunk;
+        if (c < 0 || !mapStreamResident(s, c)) continue;
+        if (victim < 0 || s.slots[k].lastUsed < s.slots[victim].lastUsed) victim = (int)k;
+    }
+    if (victim < 0 || s.slots[victim].lastUsed == s.clock) return -1;  // 全是这一帧要用的块
+    int c = s.slots[victim].chunk;
+    s.state[c].store(STREAM_ABSENT, std::memory_order_relaxed);
+    s.chunkSlot[c] = -1;
+    s.slots[victim].chunk = -1;
+    s.evictions++;
+    return victim;
+}
+
+// 主线程每帧调用：(oy, ox) 是窗口左上角所在的块，(ci, cj) 是玩家所在的格子，face 是 PLAYER_FACE_*。
+// 按优先级重新排队，队列里已经不需要的块直接撤掉；只加锁改队列，不等待读盘。
+inline void mapStreamUpdate(MapStream& s, int oy, int ox, int ci, int cj, int face) {
+    int pcy = ci / STREAM_CHUNK, pcx = cj / STREAM_CHUNK;
+    int dy = face == PLAYER_FACE_UP ? -1 : face == PLAYER_FACE_DOWN ? 1 : 0;
+    int dx = face == PLAYER_FACE_LEFT ? -1 : face == PLAYER_FACE_RIGHT ? 1 : 0;
+
+    // 窗口里的块全部要（靠近地图边缘时窗口不以玩家为中心），按离玩家的距离由近到远；再沿朝向往前预取
+    std::vector<int> wanted;
+    wanted.reserve(STREAM_WINDOW * (STREAM_WINDOW + STREAM_PREFETCH));
+    auto inWindow = [&](int cy, int cx) {
+        return cy >= oy && cx >= ox && cy < oy + STREAM_WINDOW && cx < ox + STREAM_WINDOW;
+    };
+    auto want = [&](int cy, int cx) {
+        if (cy >= 0 && cx >= 0 && cy < s.chunksY && cx < s.chunksX) wanted.push_back(cy * s.chunksX + cx);
+    };
+    for (int r = 0; r < STREAM_WINDOW; r++) {
+        for (int y = -r; y <= r; y++)
+            for (int x = -r; x <= r; x++)
+                if (std::max(std::abs(y), std::abs(x)) == r && inWindow(pcy + y, pcx + x)) want(pcy + y, pcx + x);
+    }
+    for (int d = STREAM_RADIUS + 1; d <= STREAM_RADIUS + STREAM_PREFETCH; d++) {
+        for (int w = -STREAM_RADIUS; w <= STREAM_RADIUS; w++) {
+            int cy = pcy + dy * d + dx * w, cx = pcx + dx * d + dy * w;
+            if (!inWindow(cy, cx)) want(cy, cx);
+        }
+    }
+
+    s.clock++;
+    std::lock_guard<std::mutex> guard(s.lock);
+    // 还没开始读的请求撤回，槽还给空闲表，下面按新的顺序重新排
+    for (size_t q = 0; q < s.queue.size(); q++) {
+        int k = s.queue[q];
+        s.state[k].store(STREAM_ABSENT, std::memory_order_relaxed);
+        s.slots[s.chunkSlot[k]].chunk = -1;
+        s.freeSlots.push_back(s.chunkSlot[k]);
+        s.chunkSlot[k] = -1;
+    }
+    s.queue.clear();
+    // 先把要用的常驻块都标成这一帧用过，换槽时就不会换掉它们
+    for (size_t n = 0; n < wanted.size(); n++) {
+        int slot = s.chunkSlot[wanted[n]];
+        if (slot >= 0) s.slots[slot].lastUsed = s.clock;
+    }
+    for (size_t n = 0; n < wanted.size(); n++) {
+        int k = wanted[n];
+        if (s.state[k].load(std::memory_order_relaxed) != STREAM_ABSENT) continue;
+        int slot = mapStreamTakeSlot(s);
+        if (slot < 0) break;
+        s.slots[slot].chunk = k;
+        s.slots[slot].lastUsed = s.clock;
+        s.chunkSlot[k] = slot;
+        s.state[k].store(STREAM_QUEUED, std::memory_order_relaxed);
+        s.queue.push_back(k);
+        s.requests++;
+    }
+    if (!s.queue.empty()) s.wake.notify_one();
+}
+
+// 从按行存放的地图里取出一块，地图外的格子为 0
+inline void mapStreamGatherChunk(const Map& rows, int cy, int cx, uint64_t* chunk) {
+    memset(chunk, 0, STREAM_CHUNK_BYTES);
+    for (int r = 0; r < STREAM_CHUNK && cy * STREAM_CHUNK + r < rows.height; r++) {
+        const uint64_t* row = &rows.blocks.words[(size_t)(cy * STREAM_CHUNK + r) * rows.blocks.stride];
+        for (int w = 0; w < STREAM_CHUNK_WORDS; w++) {
+            size_t k = (size_t)cx * STREAM_CHUNK_WORDS + w;
+            if (k < rows.blocks.stride) chunk[r * STREAM_CHUNK_WORDS + w] = row[k];
+        }
+    }
+}
+
+// 把地图切块、逐块压缩，写成第 2 版流式格式
+inline bool mapStreamSave(const char* path, const Map& in) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Stream: cannot open %s\n", path);
+        return false;
+    }
+    Map rows = in;
+    rows.setTiled(false);
+    int chunksX = (in.width + STREAM_CHUNK - 1) / STREAM_CHUNK;
+    int chunksY = (in.height + STREAM_CHUNK - 1) / STREAM_CHUNK;
+    StreamFileHeader h;
+    memcpy(h.magic, "MAZS", 4);
+    h.version = STREAM_FILE_VERSION;
+    h.chunkSize = STREAM_CHUNK;
+    h.width = (uint32_t)in.width;
+    h.height = (uint32_t)in.height;
+    h.markerCount = (uint32_t)in.blocks.markers.size();
+    h.reserved = 0;
+    uint64_t pos = STREAM_HEADER_SIZE + (uint64_t)h.markerCount * sizeof(MapMarker);
+    uint64_t dataOffset = (pos + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+
+    // 先把所有块压缩好，偏移表才写得出来
+    std::vector<uint64_t> index;
+    std::vector<uint8_t> data;
+    uint64_t base = dataOffset + ((uint64_t)chunksX * chunksY + 1) * sizeof(uint64_t);
+    uint64_t chunk[STREAM_CHUNK * STREAM_CHUNK_WORDS];
+    for (int cy = 0; cy < chunksY; cy++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            mapStreamGatherChunk(rows, cy, cx, chunk);
+            index.push_back(base + data.size());
+            mapStreamCompressChunk(chunk, data);
+        }
+    }
+    index.push_back(base + data.size());
+
+    std::vector<char> pad((size_t)(dataOffset - pos), 0);
+    bool ok = fwrite(&h, 1, sizeof(h), f) == sizeof(h) &&
+              fwrite(in.blocks.markers.data(), sizeof(MapMarker), h.markerCount, f) == h.markerCount &&
+              fwrite(pad.data(), 1, pad.size(), f) == pad.size() &&
+              fwrite(index.data(), sizeof(uint64_t), index.size(), f) == index.size() &&
+              fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (fclose(f) != 0) ok = false;
+    if (!ok) {
+        printf("Stream: failed to write %s\n", path);
+        return false;
+    }
+    double raw = (double)chunksX * chunksY * STREAM_CHUNK_BYTES;
+    printf("Saved chunked map %s (%d x %d, %d x %d chunks, %.1f KB compressed, %.1fx)\n", path, in.width, in.height,
+           chunksX, chunksY, data.size() / 1024.0, raw / std::max((size_t)1, data.size()));
+    return true;
+}
@@ -0,0 +1,672 @@
+#pragma once
+// 迷宫生成：房间位于奇数坐标的格子上，先在房间之间用选定的算法连出一棵生成树（完美迷宫，任意两点之间
+// 恰好一条路），再随机拆掉一些内部墙，把墙的比例降到指定的密度。同一个种子在任何平台上都生成同一张地图。
+//
+// 生成树先记在每个房间一个字节里（向右通、向下通两位），最后一次性整行写进地图，
+// 不经过逐格的 blocks[i][j]。
+// 无尽模式用的 Eller 算法不需要整张地图，一次生成一排（MazeEller）。
+// 很大的迷宫可以分区生成（generateMazeRegions）：各区在多个线程上各自生成，再用并查集沿区的边界缝起来。
+// 无限迷宫按块生成（mazeChunkWalls），每块只取决于种子和块坐标。
+#include "define.h"
+#include "bitboard.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define MAZE_ALGO_BACKTRACKER 0     // 迭代回溯法（深度优先，显式栈）：通道长而弯，分叉少
+#define MAZE_ALGO_KRUSKAL     1     // 随机 Kruskal（并查集）：分叉多，通道短
+#define MAZE_ALGO_WILSON      2     // Wilson（擦除环路的随机游走）：在所有生成树里均匀抽样
+#define MAZE_ALGO_PRIM        3     // 随机 Prim：从一点向外长，死胡同多
+#define MAZE_ALGO_COUNT       4
+
+#define MAZE_OPEN_RIGHT 1
+#define MAZE_OPEN_DOWN  2
+
+#define MAZE_REGION_ROOMS 256       // 分区生成时每个区的边长（以房间计），和线程数无关
+#define MAZE_CHUNK_CELLS  64        // 无限迷宫每块的边长（以格子计），每块 32x32 个房间
+
+static const char* const MAZE_ALGO_NAMES[MAZE_ALGO_COUNT] = { "backtracker", "kruskal", "wilson", "prim" };
+
+// 名字转成 MAZE_ALGO_*；不认识返回 -1
+inline int mazeAlgorithmByName(const char* name) {
+    for (int a = 0; a < MAZE_ALGO_COUNT; a++)
+        if (strcmp(name, MAZE_ALGO_NAMES[a]) == 0) return a;
+    return -1;
+}
+
+// splitmix64，足够快，且不依赖标准库分布的实现
+struct MazeRng {
+    uint64_t state;
+    explicit MazeRng(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    // [0, n)
+    uint32_t below(uint32_t n) { return (uint32_t)(((next() >> 32) * n) >> 32); }
+};
+
+// 从 seed 派生出第 k 个互不相关的种子（每个区一个），不依赖生成的先后顺序
+inline uint64_t mazeSubSeed(uint64_t seed, uint64_t k) {
+    MazeRng r(seed ^ (k + 1) * 0xD1B54A32D192ED03ull);
+    return r.next();
+}
+
+// 用 threads 个线程处理 0..n-1：线程从共享的计数器里取下一个编号，谁先做完谁多做；
+// threads <= 1 时就在当前线程里按顺序做
+template <typename F>
+inline void mazeParallelFor(int n, int threads, F f) {
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int k; (k = next.fetch_add(1)) < n;) f(k);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < std::min(threads, n); t++) pool.push_back(std::thread(work));
+    work();
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+// rows x cols 个房间，open[r * cols + c] 记着向右、向下是否打通
+struct MazeRooms {
+    int rows, cols;
+    std::vector<uint8_t> open;
+
+    MazeRooms(int r, int c) : rows(r), cols(c), open((size_t)r * c, 0) {}
+    int count() const { return rows * cols; }
+
+    // 打通相邻的两个房间。先比较下方：只有一列时 a + 1 也是下方的房间
+    void link(int a, int b) {
+        if (b < a) std::swap(a, b);
+        open[a] |= b == a + cols ? MAZE_OPEN_DOWN : MAZE_OPEN_RIGHT;
+    }
+    // 房间 a 四个方向（0 上 1 下 2 左 3 右）的邻居，出界的记 -1；只做一次除法
+    void neighbors(int a, int nb[4]) const {
+        int r = a / cols, c = a - r * cols;
+        nb[0] = r > 0 ? a - cols : -1;
+        nb[1] = r + 1 < rows ? a + cols : -1;
+        nb[2] = c > 0 ? a - 1 : -1;
+        nb[3] = c + 1 < cols ? a + 1 : -1;
+    }
+};
+
+// 迭代回溯：栈顶房间随机走向一个没去过的邻居，走不动就退栈。
+// 栈就是从起点到栈顶的路径，所以栈最深时的栈顶是离起点最远的房间，直接返回它
+inline int mazeBacktracker(MazeRooms& m, int start, MazeRng& rng) {
+    std::vector<uint8_t> visited(m.count(), 0);
+    std::vector<int> stack;
+    stack.reserve(m.rows + m.cols);
+    visited[start] = 1;
+    stack.push_back(start);
+    int farthest = start;
+    size_t depth = 1;
+    while (!stack.empty()) {
+        int cur = stack.back();
+        int nb[4], options[4], n = 0;
+        m.neighbors(cur, nb);
+        for (int d = 0; d < 4; d++)
+            if (nb[d] >= 0 && !visited[nb[d]]) options[n++] = nb[d];
+        if (n == 0) {
+            stack.pop_back();
+            continue;
+        }
+        int next = options[rng.below(n)];
+        visited[next] = 1;
+        m.link(cur, next);
+        stack.push_back(next);
+        if (stack.size() > depth) {
+            depth = stack.size();
+            farthest = next;
+        }
+    }
+    return farthest;
+}
+
+// 并查集：按大小合并加路径减半。根上存的是负的集合大小，父节点和大小共用一个数组，
+// 边的顺序是随机的，访问几乎都不命中缓存，少一个数组就少一半的缺失
+struct MazeDisjointSet {
+    std::vector<int> parent;
+    explicit MazeDisjointSet(int n) : parent(n, -1) {}
+    int find(int x) {
+        while (parent[x] >= 0) {
+            int p = parent[x];
+            if (parent[p] >= 0) parent[x] = parent[p];
+            x = p;
+        }
+        return x;
+    }
+    // 原本不连通时合并并返回 true
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (parent[a] > parent[b]) std::swap(a, b);
+        parent[a] += parent[b];
+        parent[b] = a;
+        return true;
+    }
+    void prefetch(int x) const {
+#ifdef _MSC_VER
+        _mm_prefetch((const char*)&parent[x], _MM_HINT_T0);
+#else
+        __builtin_prefetch(&parent[x]);
+#endif
+    }
+};
+
+// Kruskal：所有内部墙打乱顺序，墙两边还不连通就拆掉
+inline void mazeKruskal(MazeRooms& m, MazeRng& rng) {
+    // 一条边记成 房间 * 2 + (0 向右, 1 向下)
+    std::vector<uint32_t> edges;
+    edges.reserve((size_t)m.count() * 2);
+    for (int r = 0; r < m.rows; r++) {
+        for (int c = 0; c < m.cols; c++) {
+            uint32_t a = (uint32_t)(r * m.cols + c);
+            if (c + 1 < m.cols) edges.push_back(a * 2);
+            if (r + 1 < m.rows) edges.push_back(a * 2 + 1);
+        }
+    }
+    for (size_t k = edges.size(); k > 1; k--) std::swap(edges[k - 1], edges[rng.below((uint32_t)k)]);
+
+    // 提前几条边预取两端的父节点
+    const size_t AHEAD = 8;
+    MazeDisjointSet sets(m.count());
+    int remaining = m.count() - 1;
+    for (size_t k = 0; k < edges.size() && remaining > 0; k++) {
+        if (k + AHEAD < edges.size()) {
+            int a = (int)(edges[k + AHEAD] >> 1);
+            sets.prefetch(a);
+            sets.prefetch(edges[k + AHEAD] & 1 ? a + m.cols : a + 1);
+        }
+        int a = (int)(edges[k] >> 1);
+        int b = edges[k] & 1 ? a + m.cols : a + 1;
+        if (!sets.unite(a, b)) continue;
+        m.link(a, b);
+        remaining--;
+    }
+}
+
+// Wilson：从每个还不在树上的房间随机游走，直到碰到树；每个房间只记最后一次离开的方向，
+// 沿着这些方向从起点再走一遍就是擦掉环路之后的路径，把它接到树上
+inline void mazeWilson(MazeRooms& m, int root, MazeRng& rng) {
+    static const int DR[4] = { -1, 1, 0, 0 }, DC[4] = { 0, 0, -1, 1 };
+    const int step[4] = { -m.cols, m.cols, -1, 1 };
+    std::vector<uint8_t> inTree(m.count(), 0), exitDir(m.count(), 0);
+    inTree[root] = 1;
+    uint64_t bits = 0;
+    int bitsLeft = 0;
+    for (int s = 0; s < m.count(); s++) {
+        if (inTree[s]) continue;
+        // 游走时同时跟着行列走，判断出界不用做除法
+        int cur = s, r = s / m.cols, c = s % m.cols;
+        while (!inTree[cur]) {
+            // 一次取 2 位选方向，出界就重选；一个 64 位随机数够走 32 步
+            int d, nr, nc;
+            do {
+                if (bitsLeft == 0) {
+                    bits = rng.next();
+                    bitsLeft = 32;
+                }
+                d = (int)(bits & 3);
+                bits >>= 2;
+                bitsLeft--;
+                nr = r + DR[d];
+                nc = c + DC[d];
+            } while ((unsigned)nr >= (unsigned)m.rows || (unsigned)nc >= (unsigned)m.cols);
+            exitDir[cur] = (uint8_t)d;
+            cur += step[d];
+            r = nr;
+            c = nc;
+        }
+        for (cur = s; !inTree[cur];) {
+            int next = cur + step[exitDir[cur]];
+            inTree[cur] = 1;
+            m.link(cur, next);
+            cur = next;
+        }
+    }
+}
+
+// Prim：随机取一个和树相邻的房间，接到它旁边任意一个已在树上的房间
+inline void mazePrim(MazeRooms& m, int start, MazeRng& rng) {
+    const uint8_t OUTSIDE = 0, FRONTIER = 1, IN_TREE = 2;
+    std::vector<uint8_t> state(m.count(), OUTSIDE);
+    std::vector<int> frontier;
+    auto add = [&](int a, const int nb[4]) {
+        state[a] = IN_TREE;
+        for (int d = 0; d < 4; d++) {
+            if (nb[d] >= 0 && state[nb[d]] == OUTSIDE) {
+                state[nb[d]] = FRONTIER;
+                frontier.push_back(nb[d]);
+            }
+        }
+    };
+    int nb[4];
+    m.neighbors(start, nb);
+    add(start, nb);
+    while (!frontier.empty()) {
+        size_t k = rng.below((uint32_t)frontier.size());
+        int cur = frontier[k];
+        frontier[k] = frontier.back();
+        frontier.pop_back();
+        int options[4], n = 0;
+        m.neighbors(cur, nb);
+        for (int d = 0; d < 4; d++)
+            if (nb[d] >= 0 && state[nb[d]] == IN_TREE) options[n++] = nb[d];
+        m.link(cur, options[rng.below(n)]);
+        add(cur, nb);
+    }
+}
+
+// 离 start 最远的房间（树上的路径最长），用来放终点。
+// 用深度优先而不是广度优先：顺着通道走，访问的内存大多是挨着的
+inline int mazeFarthestRoom(const MazeRooms& m, int start) {
+    std::vector<uint8_t> seen(m.count(), 0);
+    std::vector<std::pair<int, int> > stack;    // 房间和它到起点的步数
+    stack.push_back(std::make_pair(start, 0));
+    seen[start] = 1;
+    int farthest = start, best = 0;
+    // 向右通的位不会出现在最后一列，向下通的位不会出现在最后一行，所以不用再判断出界
+    auto visit = [&](int nb, int dist) {
+        if (seen[nb]) return;
+        seen[nb] = 1;
+        stack.push_back(std::make_pair(nb, dist));
+    };
+    while (!stack.empty()) {
+        int cur = stack.back().first, dist = stack.back().second;
+        stack.pop_back();
+        if (dist > best) {
+            best = dist;
+            farthest = cur;
+        }
+        if (cur >= m.cols && (m.open[cur - m.cols] & MAZE_OPEN_DOWN)) visit(cur - m.cols, dist + 1);
+        if (m.open[cur] & MAZE_OPEN_DOWN) visit(cur + m.cols, dist + 1);
+        if (cur > 0 && (m.open[cur - 1] & MAZE_OPEN_RIGHT)) visit(cur - 1, dist + 1);
+        if (m.open[cur] & MAZE_OPEN_RIGHT) visit(cur + 1, dist + 1);
+    }
+    return farthest;
+}
+
+// 拼出一行墙位图（wallStride 个字）：roomRow 为真时是一排房间和它们向右的通道，
+// 否则是这排房间和下一排之间的连接行；open 为空时整行是墙
+inline void mazeRowWalls(uint64_t* row, size_t wallStride, int width, const uint8_t* open, int cols, bool roomRow) {
+    // 先整行是墙，再挖掉通的格子
+    std::fill(row, row + wallStride, ~0ull);
+    if (width % 64) row[wallStride - 1] = (1ull << (width % 64)) - 1;
+    if (!open) return;
+    for (int c = 0; c < cols; c++) {
+        int j = 2 * c + 1;
+        if (roomRow) {
+            row[j / 64] &= ~(1ull << (j % 64));
+            if (open[c] & MAZE_OPEN_RIGHT) row[(j + 1) / 64] &= ~(1ull << ((j + 1) % 64));
+        } else if (open[c] & MAZE_OPEN_DOWN) {
+            row[j / 64] &= ~(1ull << (j % 64));
+        }
+    }
+}
+
+// 把一行墙位图写成地图的第 i 行：按行存放时格子由墙位图展开，按块存放时逐格写。
+// 不处理起点和终点，这一行原来不能有标记
+inline void mazeStoreRow(Map& map, int i, const uint64_t* row) {
+    memcpy(&map.blocks.walls[(size_t)i * map.blocks.wallStride], row, map.blocks.wallStride * sizeof(uint64_t));
+    if (map.blocks.tiled) {
+        for (int j = 0; j < map.width; j++)
+            map.blocks.set(i, j, (row[j / 64] >> (j % 64)) & 1 ? MAP_BLOCK_CUBE : MAP_BLOCK_EMPTY);
+        return;
+    }
+    // 墙是 MAP_BLOCK_CUBE = 1，空地是 0：每 32 格的墙位展开到偶数位上就是格子
+    uint64_t* words = &map.blocks.words[(size_t)i * map.blocks.stride];
+    for (size_t k = 0; k < map.blocks.stride; k++)
+        words[k] = mapSpreadEvenBits(row[k / 2] >> (k % 2 * 32));
+}
+
+// 把房间写进地图（地图已经 resize 过），整行整行地写，不经过逐格的 blocks[i][j]。
+// 多线程时每个线程写 64 行一段，段的边界对齐到 8x8 块，不会有两个线程写同一个字
+inline void mazeWriteRooms(Map& map, const MazeRooms& m, int threads = 1) {
+    const int BAND = 64;
+    mazeParallelFor((map.height + BAND - 1) / BAND, threads, [&](int band) {
+        std::vector<uint64_t> row(map.blocks.wallStride);
+        for (int i = band * BAND; i < std::min(map.height, (band + 1) * BAND); i++) {
+            int r = (i - 1) / 2;
+            bool roomRow = i % 2 == 1 && r < m.rows;
+            bool linkRow = i % 2 == 0 && i / 2 >= 1 && i / 2 < m.rows;
+            const uint8_t* open = roomRow || linkRow ? &m.open[(size_t)(roomRow ? r : i / 2 - 1) * m.cols] : NULL;
+            mazeRowWalls(row.data(), row.size(), map.width, open, m.cols, roomRow);
+            mazeStoreRow(map, i, row.data());
+        }
+    });
+}
+
+// Eller：一次生成一排房间，只记着这一排每个房间属于哪个集合，内存只和宽度有关。
+// 每排先随机打通相邻的不同集合，再让每个集合至少有一个房间通向下一排；
+// 不生成收尾的最后一排，可以一直生成下去。同一个种子和宽度总是生成同样的一串排。
+struct MazeEller {
+    int cols = 0;
+    MazeRng rng;
+    std::vector<int> label;     // 这一排每个房间的集合，记成集合里最左边的房间的下标
+    std::vector<int> parent, root, members, downs, pick, first;
+    uint64_t bits = 0;
+    int bitsLeft = 0;
+
+    MazeEller() : rng(0) {}
+
+    void reset(int c, uint64_t seed) {
+        cols = c;
+        rng = MazeRng(seed);
+        bits = 0;
+        bitsLeft = 0;
+        label.resize(c);
+        for (int k = 0; k < c; k++) label[k] = k;
+        parent.resize(c);
+        root.resize(c);
+        members.resize(c);
+        downs.resize(c);
+        pick.resize(c);
+        first.resize(c);
+    }
+
+    bool coin() {
+        if (bitsLeft == 0) {
+            bits = rng.next();
+            bitsLeft = 64;
+        }
+        bool b = bits & 1;
+        bits >>= 1;
+        bitsLeft--;
+        return b;
+    }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    // 生成下一排：open[c] 的 MAZE_OPEN_RIGHT 是向右打通，MAZE_OPEN_DOWN 是通向下一排
+    void next(uint8_t* open) {
+        // 集合的编号是最左边房间的下标，编号本身就是并查集的根；合并时留下较小的编号
+        for (int c = 0; c < cols; c++) {
+            parent[c] = label[c];
+            open[c] = 0;
+        }
+        for (int c = 0; c + 1 < cols; c++) {
+            int a = find(c), b = find(c + 1);
+            if (a == b || !coin()) continue;
+            parent[std::max(a, b)] = std::min(a, b);
+            open[c] |= MAZE_OPEN_RIGHT;
+        }
+
+        for (int c = 0; c < cols; c++) {
+            root[c] = find(c);
+            members[c] = downs[c] = 0;
+        }
+        for (int c = 0; c < cols; c++) {
+            members[root[c]]++;
+            if (coin()) {
+                open[c] |= MAZE_OPEN_DOWN;
+                downs[root[c]]++;
+            }
+        }
+        // 一个也没往下通的集合随机挑一个房间往下通；根是集合最左边的房间，扫到它时成员还都在后面
+        for (int c = 0; c < cols; c++) {
+            int r = root[c];
+            if (downs[r]) continue;
+            if (c == r) pick[r] = (int)rng.below(members[r]);
+            if (pick[r]-- == 0) open[c] |= MAZE_OPEN_DOWN;
+        }
+
+        // 下一排：往下通的房间沿用集合（重新编号成最左边的那个），其余的各自成为新集合
+        for (int c = 0; c < cols; c++) first[c] = -1;
+        for (int c = 0; c < cols; c++) {
+            if (!(open[c] & MAZE_OPEN_DOWN)) {
+                label[c] = c;
+                continue;
+            }
+            int& f = first[root[c]];
+            if (f < 0) f = c;
+            label[c] = f;
+        }
+    }
+};
+
+// 用选定的算法在 rooms 上连出一棵生成树；回溯法顺带得到离 start 最远的房间，其余算法返回 -1
+inline int mazeBuildTree(MazeRooms& rooms, int algorithm, int start, MazeRng& rng) {
+    switch (algorithm) {
+    case MAZE_ALGO_KRUSKAL: mazeKruskal(rooms, rng); return -1;
+    case MAZE_ALGO_WILSON: mazeWilson(rooms, rng.below(rooms.count()), rng); return -1;
+    case MAZE_ALGO_PRIM: mazePrim(rooms, rng.below(rooms.count()), rng); return -1;
+    default: return mazeBacktracker(rooms, start, rng);
+    }
+}
+
+// 生成树写进地图，拆墙到指定密度，放上起点和终点。
+// 拆墙：只拆把两段通道隔开的内部墙，拆掉之后多出一条环路
+inline void mazeFinish(Map& map, const MazeRooms& rooms, int startRoom, int endRoom, float density, MazeRng& rng,
+                       int threads = 1) {
+    mazeWriteRooms(map, rooms, threads);
+
+    int width = map.width, height = map.height;
+    long long total = (long long)width * height;
+    long long walls = 0;
+    for (size_t k = 0; k < map.blocks.walls.size(); k++) walls += bitCount(map.blocks.walls[k]);
+    long long target = (long long)(density * total);
+    long long attempts = total * 4;
+    while (walls > target && attempts-- > 0) {
+        int i = 1 + (int)rng.below(height - 2), j = 1 + (int)rng.below(width - 2);
+        if (!map.blocks.isWall(i, j)) continue;
+        bool vertical = !map.blocks.isWall(i - 1, j) && !map.blocks.isWall(i + 1, j);
+        bool horizontal = !map.blocks.isWall(i, j - 1) && !map.blocks.isWall(i, j + 1);
+        if (!vertical && !horizontal) continue;
+        map.blocks[i][j] = MAP_BLOCK_EMPTY;
+        walls--;
+    }
+
+    int cols = rooms.cols;
+    map.blocks[2 * (startRoom / cols) + 1][2 * (startRoom % cols) + 1] = MAP_BLOCK_START;
+    map.blocks[2 * (endRoom / cols) + 1][2 * (endRoom % cols) + 1] = MAP_BLOCK_END;
+}
+
+// 至少要有两个房间，起点和终点才不会落在同一格
+inline bool mazeSizeOk(int rows, int cols) {
+    return rows >= 1 && cols >= 1 && rows * cols >= 2;
+}
+
+// density 是墙占全部格子的比例；完美迷宫本身大约是 0.5，更高的密度做不到，按完美迷宫处理。
+// 起点放在左下角的房间，终点放在树上离起点最远的房间。
+// 放不下两个房间（起点和终点各占一个）时返回 false，map 不变。
+inline bool generateMaze(Map& map, int width, int height, float density, uint64_t seed,
+                         int algorithm = MAZE_ALGO_BACKTRACKER) {
+    // 房间位于 (2r+1, 2c+1)
+    int rows = (height - 1) / 2, cols = (width - 1) / 2;
+    if (!mazeSizeOk(rows, cols) || !map.resize(width, height)) return false;
+    map.fill(MAP_BLOCK_CUBE);
+    MazeRng rng(seed);
+    MazeRooms rooms(rows, cols);
+    int startRoom = (rows - 1) * cols;
+    int endRoom = mazeBuildTree(rooms, algorithm, startRoom, rng);
+    if (endRoom < 0) endRoom = mazeFarthestRoom(rooms, startRoom);
+    mazeFinish(map, rooms, startRoom, endRoom, density, rng);
+    return true;
+}
+
+// 区内的广度优先：从 entry 出发，只在左上角为 (r0, c0)、rh x cw 的区里走。local 按区内坐标
+// （行宽固定为 MAZE_REGION_ROOMS）记每个房间离 entry 的步数，只有一个区那么大，放得进缓存；
+// 返回区内离 entry 最远的房间
+inline int mazeRegionBfs(const MazeRooms& m, int r0, int c0, int rh, int cw, int entry, std::vector<int>& local,
+                         int& farDist) {
+    const int RS = MAZE_REGION_ROOMS;
+    std::vector<int> queue((size_t)rh * cw);
+    local.assign((size_t)rh * RS, -1);
+    size_t head = 0, tail = 0;
+    int start = (entry / m.cols - r0) * RS + entry % m.cols - c0;
+    local[start] = 0;
+    queue[tail++] = start;
+    int farthest = start;
+    farDist = 0;
+    auto visit = [&](int nb, int d) {
+        if (local[nb] >= 0) return;
+        local[nb] = d;
+        queue[tail++] = nb;
+    };
+    while (head < tail) {
+        int cur = queue[head++], d = local[cur];
+        if (d > farDist) {
+            farDist = d;
+            farthest = cur;
+        }
+        int lr = cur / RS, lc = cur % RS;
+        const uint8_t* open = &m.open[(size_t)(r0 + lr) * m.cols + c0 + lc];
+        if (lr > 0 && (open[-m.cols] & MAZE_OPEN_DOWN)) visit(cur - RS, d + 1);
+        if (lr + 1 < rh && (open[0] & MAZE_OPEN_DOWN)) visit(cur + RS, d + 1);
+        if (lc > 0 && (open[-1] & MAZE_OPEN_RIGHT)) visit(cur - 1, d + 1);
+        if (lc + 1 < cw && (open[0] & MAZE_OPEN_RIGHT)) visit(cur + 1, d + 1);
+    }
+    return (r0 + farthest / RS) * m.cols + c0 + farthest % RS;
+}
+
+// 分区生成：房间按 MAZE_REGION_ROOMS 见方分成若干区，每个区用自己的种子各自生成一棵生成树，
+// 在 threads 个线程上并行；然后把区当成节点，随机打乱区之间的相邻关系，用并查集挑出一棵连通所有区的树，
+// 每条选中的相邻关系在公共边界上随机开一扇门。区内是树、区之间也是树，合起来仍是一棵生成树
+// （任意两格之间恰好一条路）。区的划分和每个区的种子只取决于 seed 和大小，所以结果和线程数无关。
+// threads <= 0 时使用全部硬件线程。
+//
+// 终点也分区找：从起点到别的区的路一定从那个区的“入口”（通向起点那一侧的门）进去，
+// 所以各区并行地从入口做区内广度优先，再沿区的树把入口的距离累加起来，不必对整张图做一遍搜索。
+inline bool generateMazeRegions(Map& map, int width, int height, float density, uint64_t seed, int algorithm,
+                                int threads) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    int rows = (height - 1) / 2, cols = (width - 1) / 2;
+    if (!mazeSizeOk(rows, cols) || !map.resize(width, height)) return false;
+    map.fill(MAP_BLOCK_CUBE);
+    MazeRooms rooms(rows, cols);
+    const int RS = MAZE_REGION_ROOMS;
+    int regionRows = (rows + RS - 1) / RS, regionCols = (cols + RS - 1) / RS, regions = regionRows * regionCols;
+    auto regionHeight = [&](int region) { return std::min(RS, rows - region / regionCols * RS); };
+    auto regionWidth = [&](int region) { return std::min(RS, cols - region % regionCols * RS); };
+
+    // 各区写 open 里互不相交的字节，不需要加锁
+    mazeParallelFor(regions, threads, [&](int region) {
+        int r0 = region / regionCols * RS, c0 = region % regionCols * RS;
+        MazeRooms local(regionHeight(region), regionWidth(region));
+        MazeRng rng(mazeSubSeed(seed, (uint64_t)region));
+        mazeBuildTree(local, algorithm, (local.rows - 1) * local.cols, rng);
+        for (int r = 0; r < local.rows; r++)
+            memcpy(&rooms.open[(size_t)(r0 + r) * cols + c0], &local.open[(size_t)r * local.cols], local.cols);
+    });
+
+    // 缝合：一条相邻关系记成 区 * 2 + (0 右边的区, 1 下边的区)；选中的门记下两侧的房间
+    MazeRng rng(mazeSubSeed(seed, (uint64_t)regions));
+    std::vector<uint32_t> edges;
+    for (int ry = 0; ry < regionRows; ry++) {
+        for (int rx = 0; rx < regionCols; rx++) {
+            uint32_t a = (uint32_t)(ry * regionCols + rx);
+            if (rx + 1 < regionCols) edges.push_back(a * 2);
+            if (ry + 1 < regionRows) edges.push_back(a * 2 + 1);
+        }
+    }
+    for (size_t k = edges.size(); k > 1; k--) std::swap(edges[k - 1], edges[rng.below((uint32_t)k)]);
+    MazeDisjointSet sets(regions);
+    std::vector<std::vector<std::pair<int, int> > > doors(regions);    // 每个区：（对面的区，本区一侧的房间）
+    for (size_t k = 0; k < edges.size(); k++) {
+        int a = (int)(edges[k] >> 1);
+        bool down = edges[k] & 1;
+        int b = down ? a + regionCols : a + 1;
+        if (!sets.unite(a, b)) continue;
+        int r0 = a / regionCols * RS, c0 = a % regionCols * RS, room, other;
+        if (down) {
+            // 门开在这个区最下面一排，通向下面那个区
+            room = (r0 + RS - 1) * cols + c0 + (int)rng.below(regionWidth(a));
+            rooms.open[room] |= MAZE_OPEN_DOWN;
+            other = room + cols;
+        } else {
+            room = (r0 + (int)rng.below(regionHeight(a))) * cols + c0 + RS - 1;
+            rooms.open[room] |= MAZE_OPEN_RIGHT;
+            other = room + 1;
+        }
+        doors[a].push_back(std::make_pair(b, room));
+        doors[b].push_back(std::make_pair(a, other));
+    }
+
+    // 区的树以起点所在的区为根：order 是广度优先的顺序，entry 是各区的入口房间
+    int startRoom = (rows - 1) * cols;
+    int startRegion = (regionRows - 1) * regionCols;
+    std::vector<int> order, parent(regions, -1), entry(regions, -1);
+    order.push_back(startRegion);
+    entry[startRegion] = startRoom;
+    for (size_t k = 0; k < order.size(); k++) {
+        int a = order[k];
+        for (size_t d = 0; d < doors[a].size(); d++) {
+            int b = doors[a][d].first;
+            if (b == parent[a]) continue;
+            parent[b] = a;
+            // 对面的门房间在 b 的门表里
+            for (size_t e = 0; e < doors[b].size(); e++)
+                if (doors[b][e].first == a) entry[b] = doors[b][e].second;
+            order.push_back(b);
+        }
+    }
+
+    // viaDist[b] 是父区里从入口走到通向 b 的门要几步，由父区的任务写；每个区只有一个父区，不会冲突
+    std::vector<int> farRoom(regions), farDist(regions), viaDist(regions, 0);
+    mazeParallelFor(regions, threads, [&](int region) {
+        int r0 = region / regionCols * RS, c0 = region % regionCols * RS;
+        std::vector<int> local;
+        farRoom[region] = mazeRegionBfs(rooms, r0, c0, regionHeight(region), regionWidth(region), entry[region],
+                                        local, farDist[region]);
+        for (size_t d = 0; d < doors[region].size(); d++) {
+            int b = doors[region][d].first, room = doors[region][d].second;
+            if (parent[b] == region) viaDist[b] = local[(room / cols - r0) * RS + room % cols - c0];
+        }
+    });
+    std::vector<long long> offset(regions, 0);
+    int endRoom = startRoom;
+    long long best = -1;
+    for (size_t k = 0; k < order.size(); k++) {
+        int a = order[k];
+        if (parent[a] >= 0) offset[a] = offset[parent[a]] + viaDist[a] + 1;
+        if (offset[a] + farDist[a] > best) {
+            best = offset[a] + farDist[a];
+            endRoom = farRoom[a];
+        }
+    }
+
+    mazeFinish(map, rooms, startRoom, endRoom, density, rng, threads);
+    return true;
+}
+
+// 无限迷宫第 (cy, cx) 块的种子：只取决于 seed 和块坐标（可以是负数）
+inline uint64_t mazeChunkSeed(uint64_t seed, long long cy, long long cx) {
+    MazeRng r(seed ^ (uint64_t)cy * 0x9E3779B97F4A7C15ull);
+    r.state ^= (uint64_t)cx * 0xC2B2AE3D27D4EB4Full;
+    return r.next();
+}
+
+// 无限迷宫的一块，walls[r] 的第 j 位是块内第 r 行第 j 列的墙。块内是 32x32 个房间的一棵生成树；
+// 第 0 行和第 0 列是和北边、西边相邻块之间的墙，各开一扇门，门的位置也由这块的种子决定。
+// 东边和南边的门由那两个邻居自己开，所以每块都和四个邻居相通，整个平面连通
+// （块与块之间有环路，块内没有）。同样的种子和块坐标总是得到同样的一块，块可以随时丢掉再生成
+inline void mazeChunkWalls(uint64_t seed, long long cy, long long cx, uint64_t walls[MAZE_CHUNK_CELLS]) {
+    const int ROOMS = MAZE_CHUNK_CELLS / 2;
+    MazeRng rng(mazeChunkSeed(seed, cy, cx));
+    int northDoor = 2 * (int)rng.below(ROOMS) + 1, westDoor = 2 * (int)rng.below(ROOMS) + 1;
+    MazeRooms rooms(ROOMS, ROOMS);
+    mazeBacktracker(rooms, (int)rng.below(rooms.count()), rng);
+    // 和 mazeWriteRooms 一样：第 2r+1 行是房间，第 2r+2 行是它和下一排之间的连接行
+    for (int i = 0; i < MAZE_CHUNK_CELLS; i++) {
+        int r = (i - 1) / 2;
+        bool roomRow = i % 2 == 1;
+        bool linkRow = i % 2 == 0 && i > 0;
+        const uint8_t* open = roomRow || linkRow ? &rooms.open[(size_t)(roomRow ? r : i / 2 - 1) * ROOMS] : NULL;
+        mazeRowWalls(&walls[i], 1, MAZE_CHUNK_CELLS, open, ROOMS, roomRow);
+    }
+    walls[0] &= ~(1ull << northDoor);
+    walls[westDoor] &= ~1ull;
+}
+
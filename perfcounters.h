@@ -0,0 +1,169 @@
+#pragma once
+// 硬件性能计数器（仅 Linux，基于 perf_event_open）：在指定区段前后读取指令数、周期数、
+// 缓存未命中和分支预测失败，按区段累计，并给出每帧和每次调用的平均值。
+// 用来判断迷宫格子的存储布局是不是受缓存限制，不需要再开外部 profiler。
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PERF_COUNTERS 4
+#define PERF_MAX_ZONES 8
+
+static const char* const PERF_COUNTER_NAMES[PERF_COUNTERS] = {
+    "instructions", "cycles", "cache-misses", "branch-misses"
+};
+
+struct PerfZone {
+    const char* name;
+    uint64_t frame[PERF_COUNTERS];      // 本帧累计
+    uint64_t last[PERF_COUNTERS];       // 上一帧（HUD 显示）
+    uint64_t total[PERF_COUNTERS];
+    uint64_t calls;
+};
+
+struct PerfCounters {
+    bool enabled = false;
+    int fds[PERF_COUNTERS] = { -1, -1, -1, -1 };
+    int zoneCount = 0;
+    int depth = 0;                      // 区段嵌套时只统计最外层，避免重复计数
+    uint64_t frames = 0;
+    PerfZone zones[PERF_MAX_ZONES];
+};
+
+inline PerfCounters& perfCounters() {
+    static PerfCounters p;
+    return p;
+}
+
+inline int perfRegister(const char* name) {
+    PerfCounters& p = perfCounters();
+    if (p.zoneCount >= PERF_MAX_ZONES) return -1;
+    PerfZone& z = p.zones[p.zoneCount];
+    memset(&z, 0, sizeof(z));
+    z.name = name;
+    return p.zoneCount++;
+}
+
+#ifdef __linux__
+inline int perfOpen(uint64_t config, int groupFd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = groupFd < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+// 四个计数器放在同一组里，一次 read() 同时读出
+inline bool perfInit() {
+    PerfCounters& p = perfCounters();
+    if (p.enabled) return true;
+#ifdef __linux__
+    const uint64_t configs[PERF_COUNTERS] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        p.fds[i] = perfOpen(configs[i], i == 0 ? -1 : p.fds[0]);
+        if (p.fds[i] < 0) {
+            printf("Perf: cannot open %s counter (check /proc/sys/kernel/perf_event_paranoid)\n",
+                   PERF_COUNTER_NAMES[i]);
+            for (int k = 0; k < i; k++) close(p.fds[k]);
+            return false;
+        }
+    }
+    ioctl(p.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(p.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    p.enabled = true;
+    printf("Perf: hardware counters enabled\n");
+    return true;
+#else
+    printf("Perf: hardware counters are only available on Linux\n");
+    return false;
+#endif
+}
+
+inline void perfRead(uint64_t* values) {
+#ifdef __linux__
+    uint64_t buf[1 + PERF_COUNTERS];
+    if (read(perfCounters().fds[0], buf, sizeof(buf)) == (ssize_t)sizeof(buf)) {
+        memcpy(values, buf + 1, sizeof(uint64_t) * PERF_COUNTERS);
+        return;
+    }
+#endif
+    memset(values, 0, sizeof(uint64_t) * PERF_COUNTERS);
+}
+
+struct PerfScope {
+    int id;
+    bool active;
+    uint64_t start[PERF_COUNTERS];
+    explicit PerfScope(int zone) : id(-1), active(false) {
+        PerfCounters& p = perfCounters();
+        if (!p.enabled) return;
+        active = true;
+        if (p.depth++ == 0 && zone >= 0) {
+            id = zone;
+            perfRead(start);
+        }
+    }
+    ~PerfScope() {
+        if (!active) return;
+        PerfCounters& p = perfCounters();
+        p.depth--;
+        if (id < 0) return;
+        uint64_t end[PERF_COUNTERS];
+        perfRead(end);
+        PerfZone& z = p.zones[id];
+        for (int i = 0; i < PERF_COUNTERS; i++) z.frame[i] += end[i] - start[i];
+        z.calls++;
+    }
+};
+
+inline void perfFrameEnd() {
+    PerfCounters& p = perfCounters();
+    if (!p.enabled) return;
+    for (int i = 0; i < p.zoneCount; i++) {
+        PerfZone& z = p.zones[i];
+        for (int k = 0; k < PERF_COUNTERS; k++) {
+            z.last[k] = z.frame[k];
+            z.total[k] += z.frame[k];
+            z.frame[k] = 0;
+        }
+    }
+    p.frames++;
+}
+
+inline void perfReport() {
+    PerfCounters& p = perfCounters();
+    if (!p.enabled) return;
+    printf("Perf counters over %llu frames (per frame / per call):\n", (unsigned long long)p.frames);
+    for (int i = 0; i < p.zoneCount; i++) {
+        const PerfZone& z = p.zones[i];
+        if (!z.calls) continue;
+        double frames = p.frames ? (double)p.frames : 1.0;
+        printf("  %-12s calls %llu  IPC %.2f\n", z.name, (unsigned long long)z.calls,
+               z.total[1] ? (double)z.total[0] / z.total[1] : 0.0);
+        for (int k = 0; k < PERF_COUNTERS; k++)
+            printf("    %-14s %14.0f / %12.0f\n", PERF_COUNTER_NAMES[k],
+                   z.total[k] / frames, (double)z.total[k] / z.calls);
+    }
+}
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+#define PERF_ZONE(name) \
+    static const int PERF_CONCAT(perfZoneId_, __LINE__) = perfRegister(name); \
+    PerfScope PERF_CONCAT(perfScope_, __LINE__)(PERF_CONCAT(perfZoneId_, __LINE__))
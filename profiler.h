@@ -0,0 +1,151 @@
+#pragma once
+// 帧内分段性能统计：每个区段记录 CPU 时间和 GPU 时间（GL_TIME_ELAPSED 查询，晚两帧读取），
+// 结果按最近 PROFILE_AVG_FRAMES 帧做滑动平均。区段同时也会记进时间线追踪（trace.h）
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#include <chrono>
+#include <cstring>
+#include "trace.h"
+
+#define PROFILE_MAX_ZONES 16
+#define PROFILE_QUERY_FRAMES 3      // 查询环形缓冲的帧数，读取的是最早的那一帧
+#define PROFILE_AVG_FRAMES 60
+
+struct ProfileZone {
+    const char* name;
+    bool gpu;                                   // 是否发出 GPU 计时查询
+    double cpuStart;
+    double cpuFrame;                            // 本帧累计的 CPU 毫秒数
+    double cpuHistory[PROFILE_AVG_FRAMES];
+    double gpuHistory[PROFILE_AVG_FRAMES];
+    double cpuAvg, gpuAvg;
+    unsigned gpuSamples;
+    GLuint queries[PROFILE_QUERY_FRAMES];
+    bool issued[PROFILE_QUERY_FRAMES];
+};
+
+struct Profiler {
+    bool enabled = false;
+    bool gpuTimers = false;                     // 驱动是否支持计时查询
+    bool initialized = false;
+    int zoneCount = 0;
+    int activeGpuZone = -1;                     // GL_TIME_ELAPSED 不能嵌套
+    unsigned frame = 0;
+    double lastFrameEnd = 0;
+    double frameHistory[PROFILE_AVG_FRAMES];
+    double frameAvg = 0;
+    ProfileZone zones[PROFILE_MAX_ZONES];
+};
+
+inline Profiler& profiler() {
+    static Profiler p;
+    return p;
+}
+
+inline double profileNow() {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline int profileRegister(const char* name, bool gpu) {
+    Profiler& p = profiler();
+    if (p.zoneCount >= PROFILE_MAX_ZONES) return -1;
+    ProfileZone& z = p.zones[p.zoneCount];
+    memset(&z, 0, sizeof(z));
+    z.name = name;
+    z.gpu = gpu;
+    return p.zoneCount++;
+}
+
+// 需要当前 GL 上下文，第一次启用时调用
+inline void profileInitGL() {
+    Profiler& p = profiler();
+    if (p.initialized) return;
+    p.initialized = true;
+    const char* ext = (const char*)glGetString(GL_EXTENSIONS);
+    const char* ver = (const char*)glGetString(GL_VERSION);
+    p.gpuTimers = (ext && (strstr(ext, "GL_EXT_timer_query") || strstr(ext, "GL_ARB_timer_query"))) ||
+                  (ver && (ver[0] > '3' || (ver[0] == '3' && ver[2] >= '3')));
+    if (!p.gpuTimers) printf("Profiler: timer queries not supported, GPU times unavailable\n");
+}
+
+inline void profileSetEnabled(bool on) {
+    Profiler& p = profiler();
+    if (on) profileInitGL();
+    p.enabled = on;
+    p.lastFrameEnd = 0;
+}
+
+inline void profileBegin(int id) {
+    Profiler& p = profiler();
+    if (id < 0) return;
+    ProfileZone& z = p.zones[id];
+    z.cpuStart = profileNow();
+    if (z.gpu && p.gpuTimers && p.activeGpuZone < 0) {
+        int slot = p.frame % PROFILE_QUERY_FRAMES;
+        if (!z.queries[0]) glGenQueries(PROFILE_QUERY_FRAMES, z.queries);
+        glBeginQuery(GL_TIME_ELAPSED_EXT, z.queries[slot]);
+        z.issued[slot] = true;
+        p.activeGpuZone = id;
+    }
+}
+
+inline void profileEnd(int id) {
+    Profiler& p = profiler();
+    if (id < 0) return;
+    ProfileZone& z = p.zones[id];
+    z.cpuFrame += (profileNow() - z.cpuStart) * 1000.0;
+    if (p.activeGpuZone == id) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        p.activeGpuZone = -1;
+    }
+}
+
+inline double profileAverage(double* history, double value, unsigned index) {
+    history[index % PROFILE_AVG_FRAMES] = value;
+    unsigned n = index + 1 < PROFILE_AVG_FRAMES ? index + 1 : PROFILE_AVG_FRAMES;
+    double sum = 0;
+    for (unsigned k = 0; k < n; k++) sum += history[k];
+    return sum / n;
+}
+
+// 每帧结束时调用：汇总 CPU 时间，读取最早那一帧的 GPU 查询（结果没回来就沿用上次的值）
+inline void profileFrameEnd() {
+    Profiler& p = profiler();
+    if (!p.enabled) return;
+    double t = profileNow();
+    if (p.lastFrameEnd > 0)
+        p.frameAvg = profileAverage(p.frameHistory, (t - p.lastFrameEnd) * 1000.0, p.frame - 1);
+    p.lastFrameEnd = t;
+
+    int oldest = (p.frame + 1) % PROFILE_QUERY_FRAMES;
+    for (int i = 0; i < p.zoneCount; i++) {
+        ProfileZone& z = p.zones[i];
+        z.cpuAvg = profileAverage(z.cpuHistory, z.cpuFrame, p.frame);
+        z.cpuFrame = 0;
+        if (!z.issued[oldest]) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(z.queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64EXT ns = 0;
+        glGetQueryObjectui64vEXT(z.queries[oldest], GL_QUERY_RESULT, &ns);
+        z.issued[oldest] = false;
+        z.gpuAvg = profileAverage(z.gpuHistory, ns / 1.0e6, z.gpuSamples++);
+    }
+    p.frame++;
+}
+
+struct ProfileScope {
+    int id;
+    explicit ProfileScope(int zone) : id(profiler().enabled ? zone : -1) { profileBegin(id); }
+    ~ProfileScope() { profileEnd(id); }
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_ZONE_IMPL(name, gpu) \
+    static const int PROFILE_CONCAT(profileZoneId_, __LINE__) = profileRegister(name, gpu); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileZoneId_, __LINE__)); \
+    TRACE_SCOPE(name)
+#define PROFILE_ZONE(name) PROFILE_ZONE_IMPL(name, true)
+#define PROFILE_ZONE_CPU(name) PROFILE_ZONE_IMPL(name, false)
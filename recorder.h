@@ -0,0 +1,204 @@
+#pragma once
+// 录像：渲染线程把 RGBA 帧放进有界无锁队列，后台线程转换成 YUV420 并写 Y4M
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include "trace.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RECORDER_SSE2 1
+#endif
+
+#define RECORDER_QUEUE_SIZE 8   // 必须是 2 的幂
+#define RECORDER_FPS 60
+
+struct RecorderSlot {
+    std::vector<unsigned char> rgba;
+    unsigned repeat;            // 这一帧在 60fps 时间轴上占几帧（渲染慢或丢帧时补齐）
+};
+
+struct FrameRecorder {
+    int width = 0, height = 0;
+    FILE* out = NULL;
+    bool isPipe = false;
+
+    RecorderSlot slots[RECORDER_QUEUE_SIZE];
+    std::atomic<unsigned> head{0};   // 生产者（渲染线程）写
+    std::atomic<unsigned> tail{0};   // 消费者（编码线程）写
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    std::vector<unsigned char> yuv;
+    unsigned pendingRepeat = 0;      // 丢掉的帧累计到下一帧
+    unsigned captured = 0, dropped = 0;
+    std::atomic<unsigned> written{0};
+};
+
+// ---------------- RGBA -> I420 (JFIF 全范围系数) ----------------
+inline void recorderConvertRows(const unsigned char* row0, const unsigned char* row1, int w,
+                                unsigned char* y0, unsigned char* y1,
+                                unsigned char* u, unsigned char* v) {
+    int x = 0;
+#ifdef RECORDER_SSE2
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i cYR = _mm_set1_epi16(77), cYG = _mm_set1_epi16(150), cYB = _mm_set1_epi16(29);
+    const __m128i cUR = _mm_set1_epi16(-43), cUG = _mm_set1_epi16(-85), cUB = _mm_set1_epi16(128);
+    const __m128i cVR = _mm_set1_epi16(128), cVG = _mm_set1_epi16(-107), cVB = _mm_set1_epi16(-21);
+    const __m128i round = _mm_set1_epi16(128), ones = _mm_set1_epi16(1);
+    for (; x + 8 <= w; x += 8) {
+        __m128i r[2], g[2], b[2];
+        const unsigned char* rows[2] = { row0 + x * 4, row1 + x * 4 };
+        unsigned char* ys[2] = { y0 + x, y1 + x };
+        for (int k = 0; k < 2; k++) {
+            __m128i p0 = _mm_loadu_si128((const __m128i*)rows[k]);
+            __m128i p1 = _mm_loadu_si128((const __m128i*)(rows[k] + 16));
+            r[k] = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+            g[k] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                                   _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+            b[k] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                                   _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+            __m128i yy = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r[k], cYR), _mm_mullo_epi16(g[k], cYG)),
+                                       _mm_add_epi16(_mm_mullo_epi16(b[k], cYB), round));
+            yy = _mm_srli_epi16(yy, 8);
+            _mm_storel_epi64((__m128i*)ys[k], _mm_packus_epi16(yy, yy));
+        }
+        // 2x2 求平均：先纵向相加，再用 madd 横向两两相加
+        __m128i rs = _mm_madd_epi16(_mm_add_epi16(r[0], r[1]), ones);
+        __m128i gs = _mm_madd_epi16(_mm_add_epi16(g[0], g[1]), ones);
+        __m128i bs = _mm_madd_epi16(_mm_add_epi16(b[0], b[1]), ones);
+        rs = _mm_srli_epi32(rs, 2); gs = _mm_srli_epi32(gs, 2); bs = _mm_srli_epi32(bs, 2);
+        rs = _mm_packs_epi32(rs, rs); gs = _mm_packs_epi32(gs, gs); bs = _mm_packs_epi32(bs, bs);
+        // 三项之和在 ±32640 以内；纯蓝的 U、纯红的 V 加上舍入后是 32768，用饱和加法停在 32767
+        __m128i uu = _mm_adds_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rs, cUR), _mm_mullo_epi16(gs, cUG)),
+                                                  _mm_mullo_epi16(bs, cUB)), round);
+        __m128i vv = _mm_adds_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rs, cVR), _mm_mullo_epi16(gs, cVG)),
+                                                  _mm_mullo_epi16(bs, cVB)), round);
+        uu = _mm_add_epi16(_mm_srai_epi16(uu, 8), round);
+        vv = _mm_add_epi16(_mm_srai_epi16(vv, 8), round);
+        int ui = _mm_cvtsi128_si32(_mm_packus_epi16(uu, uu));
+        int vi = _mm_cvtsi128_si32(_mm_packus_epi16(vv, vv));
+        memcpy(u + x / 2, &ui, 4);
+        memcpy(v + x / 2, &vi, 4);
+    }
+#endif
+    for (; x + 2 <= w; x += 2) {
+        int rs = 0, gs = 0, bs = 0;
+        for (int k = 0; k < 2; k++) {
+            const unsigned char* p0 = row0 + (x + k) * 4;
+            const unsigned char* p1 = row1 + (x + k) * 4;
+            y0[x + k] = (unsigned char)((77 * p0[0] + 150 * p0[1] + 29 * p0[2] + 128) >> 8);
+            y1[x + k] = (unsigned char)((77 * p1[0] + 150 * p1[1] + 29 * p1[2] + 128) >> 8);
+            rs += p0[0] + p1[0]; gs += p0[1] + p1[1]; bs += p0[2] + p1[2];
+        }
+        rs >>= 2; gs >>= 2; bs >>= 2;
+        u[x / 2] = (unsigned char)std::min(((-43 * rs - 85 * gs + 128 * bs + 128) >> 8) + 128, 255);
+        v[x / 2] = (unsigned char)std::min(((128 * rs - 107 * gs - 21 * bs + 128) >> 8) + 128, 255);
+    }
+}
+
+// OpenGL 读回的图像是自下而上的，这里顺便翻转
+inline void recorderConvertFrame(const unsigned char* rgba, int w, int h, unsigned char* yuv) {
+    unsigned char* Y = yuv;
+    unsigned char* U = Y + w * h;
+    unsigned char* V = U + (w / 2) * (h / 2);
+    for (int row = 0; row + 1 < h; row += 2) {
+        const unsigned char* src0 = rgba + (size_t)(h - 1 - row) * w * 4;
+        const unsigned char* src1 = rgba + (size_t)(h - 2 - row) * w * 4;
+        recorderConvertRows(src0, src1, w, Y + row * w, Y + (row + 1) * w,
+                            U + (row / 2) * (w / 2), V + (row / 2) * (w / 2));
+    }
+}
+
+// ---------------- 编码线程 ----------------
+inline void recorderWorker(FrameRecorder* rec) {
+    traceSetThreadName("recorder");
+    for (;;) {
+        unsigned t = rec->tail.load(std::memory_order_relaxed);
+        if (t == rec->head.load(std::memory_order_acquire)) {
+            if (!rec->running.load(std::memory_order_acquire)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        TRACE_SCOPE("encodeFrame");
+        RecorderSlot& slot = rec->slots[t % RECORDER_QUEUE_SIZE];
+        recorderConvertFrame(slot.rgba.data(), rec->width, rec->height, rec->yuv.data());
+        for (unsigned k = 0; k < slot.repeat; k++) {
+            fputs("FRAME\n", rec->out);
+            fwrite(rec->yuv.data(), 1, rec->yuv.size(), rec->out);
+        }
+        rec->written.fetch_add(slot.repeat, std::memory_order_relaxed);
+        rec->tail.store(t + 1, std::memory_order_release);
+    }
+}
+
+// path 以 '|' 开头时写入管道，例如 "|ffmpeg -i - out.mp4"
+inline bool recorderStart(FrameRecorder& rec, const char* path, int w, int h) {
+    if (rec.running) return false;
+    w &= ~1; h &= ~1;   // YUV420 需要偶数尺寸
+    rec.isPipe = path[0] == '|';
+#ifdef _WIN32
+    rec.out = rec.isPipe ? _popen(path + 1, "wb") : fopen(path, "wb");
+#else
+    rec.out = rec.isPipe ? popen(path + 1, "w") : fopen(path, "wb");
+#endif
+    if (!rec.out) {
+        printf("Recorder: cannot open %s\n", path);
+        return false;
+    }
+    rec.width = w;
+    rec.height = h;
+    rec.yuv.resize((size_t)w * h * 3 / 2);
+    for (int i = 0; i < RECORDER_QUEUE_SIZE; i++)
+        rec.slots[i].rgba.resize((size_t)w * h * 4);
+    rec.head = rec.tail = 0;
+    rec.pendingRepeat = rec.captured = rec.dropped = 0;
+    rec.written = 0;
+    fprintf(rec.out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, RECORDER_FPS);
+
+    rec.running = true;
+    rec.worker = std::thread(recorderWorker, &rec);
+    printf("Recording to %s (%d x %d @ %d fps)\n", path, w, h, RECORDER_FPS);
+    return true;
+}
+
+// 队列满时返回 NULL，调用方直接丢帧，绝不等待编码线程
+inline unsigned char* recorderAcquire(FrameRecorder& rec, unsigned repeat) {
+    unsigned h = rec.head.load(std::memory_order_relaxed);
+    if (h - rec.tail.load(std::memory_order_acquire) >= RECORDER_QUEUE_SIZE) {
+        rec.dropped += repeat;
+        rec.pendingRepeat += repeat;
+        return NULL;
+    }
+    RecorderSlot& slot = rec.slots[h % RECORDER_QUEUE_SIZE];
+    slot.repeat = repeat + rec.pendingRepeat;
+    rec.pendingRepeat = 0;
+    return slot.rgba.data();
+}
+
+inline void recorderCommit(FrameRecorder& rec) {
+    rec.captured++;
+    rec.head.store(rec.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+inline void recorderStop(FrameRecorder& rec) {
+    if (!rec.running) return;
+    rec.running = false;
+    rec.worker.join();
+    if (rec.isPipe) {
+#ifdef _WIN32
+        _pclose(rec.out);
+#else
+        pclose(rec.out);
+#endif
+    } else {
+        fclose(rec.out);
+    }
+    rec.out = NULL;
+    printf("Recording stopped: %u captured, %u dropped, %u frames written\n",
+           rec.captured, rec.dropped, rec.written.load());
+}
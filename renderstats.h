@@ -0,0 +1,121 @@
+#pragma once
+// 每帧渲染统计：绘制调用、图元、顶点、纹理绑定、状态切换，以及参与判断和实际绘制的格子数。
+// 迷宫和方块的绘制代码通过下面这些包装函数调用 OpenGL，顺便计数。
+#include <OpenGL/gl.h>
+#include <cstdio>
+
+struct RenderStats {
+    unsigned drawCalls;
+    unsigned primitives;
+    unsigned vertices;
+    unsigned textureBinds;
+    unsigned stateChanges;
+    unsigned cellsConsidered;
+    unsigned cellsDrawn;
+};
+
+struct RenderStatsState {
+    RenderStats frame;      // 正在累计的这一帧
+    RenderStats last;       // 上一个完整的帧（HUD 显示这个）
+    GLenum mode;
+    unsigned modeVertices;
+    unsigned frameIndex;
+    FILE* dump;
+};
+
+inline RenderStatsState& renderStats() {
+    static RenderStatsState s = {};
+    return s;
+}
+
+inline void statBegin(GLenum mode) {
+    RenderStatsState& s = renderStats();
+    s.frame.drawCalls++;
+    s.mode = mode;
+    s.modeVertices = 0;
+    glBegin(mode);
+}
+
+inline void statEnd() {
+    RenderStatsState& s = renderStats();
+    unsigned n = s.modeVertices;
+    switch (s.mode) {
+        case GL_QUADS: s.frame.primitives += n / 4; break;
+        case GL_TRIANGLES: s.frame.primitives += n / 3; break;
+        case GL_LINES: s.frame.primitives += n / 2; break;
+        case GL_POINTS: s.frame.primitives += n; break;
+        case GL_QUAD_STRIP: s.frame.primitives += n >= 4 ? (n - 2) / 2 : 0; break;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN: s.frame.primitives += n >= 3 ? n - 2 : 0; break;
+        default: s.frame.primitives += n > 0 ? 1 : 0; break;
+    }
+    glEnd();
+}
+
+inline void statVertex3f(GLfloat x, GLfloat y, GLfloat z) {
+    RenderStatsState& s = renderStats();
+    s.frame.vertices++;
+    s.modeVertices++;
+    glVertex3f(x, y, z);
+}
+
+inline void statBindTexture(GLenum target, GLuint id) {
+    renderStats().frame.textureBinds++;
+    glBindTexture(target, id);
+}
+
+inline void statEnable(GLenum cap) {
+    renderStats().frame.stateChanges++;
+    glEnable(cap);
+}
+
+inline void statDisable(GLenum cap) {
+    renderStats().frame.stateChanges++;
+    glDisable(cap);
+}
+
+inline void statColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+    renderStats().frame.stateChanges++;
+    glColorMask(r, g, b, a);
+}
+
+inline void statDepthMask(GLboolean flag) {
+    renderStats().frame.stateChanges++;
+    glDepthMask(flag);
+}
+
+inline void statCells(unsigned considered, unsigned drawn) {
+    RenderStatsState& s = renderStats();
+    s.frame.cellsConsidered += considered;
+    s.frame.cellsDrawn += drawn;
+}
+
+// 每帧一行 CSV，方便用脚本分析
+inline bool statOpenDump(const char* path) {
+    RenderStatsState& s = renderStats();
+    s.dump = fopen(path, "w");
+    if (!s.dump) {
+        printf("Stats: cannot open %s\n", path);
+        return false;
+    }
+    fprintf(s.dump, "frame,draw_calls,primitives,vertices,texture_binds,state_changes,cells_considered,cells_drawn\n");
+    return true;
+}
+
+inline void statCloseDump() {
+    RenderStatsState& s = renderStats();
+    if (s.dump) fclose(s.dump);
+    s.dump = NULL;
+}
+
+inline void statFrameEnd() {
+    RenderStatsState& s = renderStats();
+    s.last = s.frame;
+    s.frame = RenderStats();
+    if (s.dump) {
+        const RenderStats& r = s.last;
+        fprintf(s.dump, "%u,%u,%u,%u,%u,%u,%u,%u\n", s.frameIndex, r.drawCalls, r.primitives, r.vertices,
+                r.textureBinds, r.stateChanges, r.cellsConsidered, r.cellsDrawn);
+    }
+    s.frameIndex++;
+}
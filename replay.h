@@ -0,0 +1,264 @@
+#pragma once
+// 输入/时间回放日志：记录送进 special()/keyboard() 的每个按键和 idle() 用到的每个 dt，
+// 回放时按同样的顺序重新执行，得到逐位相同的游戏状态。
+//
+// 文件格式：魔数 "MZRL"、版本，然后是地图尺寸和地图哈希（varint），之后是一串 varint 记录，
+// 低 2 位是类型：
+//   0  dt 与最近用过的第 k 个值相同，k = (v >> 2) & 3，连续 (v >> 4) + 1 帧
+//   1  新的 dt，v >> 2 是它与最近一个 dt 的位异或
+//   2  special 按键，v >> 2 是键值
+//   3  keyboard 按键，v >> 2 是键值；v >> 2 == REPLAY_END_MARK 表示结尾，后面跟状态哈希
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+#define REPLAY_VERSION 1
+#define REPLAY_END_MARK 256
+
+#define REPLAY_DT       0
+#define REPLAY_SPECIAL  1
+#define REPLAY_KEYBOARD 2
+#define REPLAY_END      3
+#define REPLAY_ERROR    4
+
+inline uint32_t replayHash(uint32_t h, const void* data, size_t n) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;     // FNV-1a
+    }
+    return h;
+}
+
+inline uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    return u;
+}
+
+inline float bitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+// 最近用过的 4 个 dt，编码和解码两边以同样的方式更新
+struct ReplayDtCache {
+    uint32_t recent[4];
+    void reset() { memset(recent, 0, sizeof(recent)); }
+    int find(uint32_t bits) const {
+        for (int k = 0; k < 4; k++)
+            if (recent[k] == bits) return k;
+        return -1;
+    }
+    void touch(int k) {
+        uint32_t v = recent[k];
+        memmove(recent + 1, recent, k * sizeof(uint32_t));
+        recent[0] = v;
+    }
+    void push(uint32_t bits) {
+        memmove(recent + 1, recent, 3 * sizeof(uint32_t));
+        recent[0] = bits;
+    }
+};
+
+// ---------------- 写 ----------------
+struct ReplayWriter {
+    FILE* out = NULL;
+    ReplayDtCache cache;
+    int runIndex = -1;          // 尚未写出的连续相同 dt
+    uint64_t runLength = 0;
+    uint64_t frames = 0, events = 0;
+};
+
+inline void replayPutVarint(FILE* f, uint64_t v) {
+    unsigned char buf[10];
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (unsigned char)v;
+    fwrite(buf, 1, n, f);
+}
+
+inline void replayFlushRun(ReplayWriter& w) {
+    if (w.runIndex < 0) return;
+    replayPutVarint(w.out, ((w.runLength - 1) << 4) | ((uint64_t)w.runIndex << 2) | 0);
+    w.cache.touch(w.runIndex);
+    w.runIndex = -1;
+    w.runLength = 0;
+}
+
+inline bool replayOpenWrite(ReplayWriter& w, const char* path, int width, int height, uint32_t mapHash) {
+    w.out = fopen(path, "wb");
+    if (!w.out) {
+        printf("Replay: cannot open %s\n", path);
+        return false;
+    }
+    fwrite("MZRL", 1, 4, w.out);
+    replayPutVarint(w.out, REPLAY_VERSION);
+    replayPutVarint(w.out, (uint64_t)width);
+    replayPutVarint(w.out, (uint64_t)height);
+    replayPutVarint(w.out, mapHash);
+    w.cache.reset();
+    w.runIndex = -1;
+    w.runLength = 0;
+    w.frames = w.events = 0;
+    printf("Recording input to %s\n", path);
+    return true;
+}
+
+inline void replayWriteDt(ReplayWriter& w, float dt) {
+    if (!w.out) return;
+    w.frames++;
+    uint32_t bits = floatBits(dt);
+    int k = w.cache.find(bits);
+    if (k >= 0 && k == w.runIndex) {
+        w.runLength++;
+        return;
+    }
+    // 写出上一段会把它的 dt 挪到缓存最前面，k 要重新找
+    replayFlushRun(w);
+    k = w.cache.find(bits);
+    if (k >= 0) {
+        w.runIndex = k;
+        w.runLength = 1;
+        return;
+    }
+    replayPutVarint(w.out, ((uint64_t)(bits ^ w.cache.recent[0]) << 2) | 1);
+    w.cache.push(bits);
+}
+
+inline void replayWriteKey(ReplayWriter& w, bool special, int key) {
+    if (!w.out) return;
+    w.events++;
+    replayFlushRun(w);
+    replayPutVarint(w.out, ((uint64_t)key << 2) | (special ? 2 : 3));
+}
+
+// 结尾写入最终状态的哈希，回放时用来校验
+inline void replayCloseWrite(ReplayWriter& w, uint32_t stateHash) {
+    if (!w.out) return;
+    replayFlushRun(w);
+    replayPutVarint(w.out, ((uint64_t)REPLAY_END_MARK << 2) | 3);
+    replayPutVarint(w.out, stateHash);
+    long size = ftell(w.out);
+    fclose(w.out);
+    w.out = NULL;
+    printf("Input log closed: %llu frames, %llu events, %ld bytes\n",
+           (unsigned long long)w.frames, (unsigned long long)w.events, size);
+}
+
+// ---------------- 读 ----------------
+struct ReplayReader {
+    std::vector<unsigned char> data;
+    size_t pos = 0;
+    ReplayDtCache cache;
+    int runIndex = -1;
+    uint64_t runLeft = 0;
+    int width = 0, height = 0;
+    uint32_t mapHash = 0;
+};
+
+inline bool replayGetVarint(ReplayReader& r, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; r.pos < r.data.size() && shift < 64; shift += 7) {
+        unsigned char b = r.data[r.pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool replayOpenRead(ReplayReader& r, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Replay: cannot open %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    r.data.resize(size > 0 ? size : 0);
+    size_t got = r.data.empty() ? 0 : fread(r.data.data(), 1, r.data.size(), f);
+    fclose(f);
+
+    uint64_t version, w, h, hash;
+    r.pos = 4;
+    if (got != r.data.size() || got < 4 || memcmp(r.data.data(), "MZRL", 4) != 0 ||
+        !replayGetVarint(r, version) || version != REPLAY_VERSION ||
+        !replayGetVarint(r, w) || !replayGetVarint(r, h) || !replayGetVarint(r, hash)) {
+        printf("Replay: %s is not a version %d input log\n", path, REPLAY_VERSION);
+        return false;
+    }
+    r.width = (int)w;
+    r.height = (int)h;
+    r.mapHash = (uint32_t)hash;
+    r.cache.reset();
+    r.runIndex = -1;
+    r.runLeft = 0;
+    return true;
+}
+
+// 读出下一条记录：REPLAY_DT 时 dt 有效，按键时 key 有效，REPLAY_END 时 hash 有效
+inline int replayNext(ReplayReader& r, float& dt, int& key, uint32_t& hash) {
+    if (r.runLeft > 0) {
+        dt = bitsFloat(r.cache.recent[0]);
+        r.runLeft--;
+        return REPLAY_DT;
+    }
+    uint64_t v;
+    if (!replayGetVarint(r, v)) return REPLAY_ERROR;
+    switch (v & 3) {
+        case 0: {
+            int k = (int)((v >> 2) & 3);
+            r.cache.touch(k);
+            r.runLeft = v >> 4;
+            dt = bitsFloat(r.cache.recent[0]);
+            return REPLAY_DT;
+        }
+        case 1: {
+            uint32_t bits = (uint32_t)(v >> 2) ^ r.cache.recent[0];
+            r.cache.push(bits);
+            dt = bitsFloat(bits);
+            return REPLAY_DT;
+        }
+        case 2:
+            key = (int)(v >> 2);
+            return REPLAY_SPECIAL;
+        default: {
+            key = (int)(v >> 2);
+            if (key != REPLAY_END_MARK) return REPLAY_KEYBOARD;
+            uint64_t h;
+            if (!replayGetVarint(r, h)) return REPLAY_ERROR;
+            hash = (uint32_t)h;
+            return REPLAY_END;
+        }
+    }
+}
+
+// 把一串 dt 编码进临时文件再解码，检查读回来的每一位都一样；返回第一个不一致的下标，全部一致返回 -1
+inline long replayCheckDts(const float* dts, size_t n) {
+    ReplayWriter w;
+    w.out = tmpfile();
+    if (!w.out) return 0;
+    w.cache.reset();
+    for (size_t i = 0; i < n; i++) replayWriteDt(w, dts[i]);
+    replayFlushRun(w);
+    ReplayReader r;
+    r.data.resize(ftell(w.out));
+    rewind(w.out);
+    size_t got = r.data.empty() ? 0 : fread(r.data.data(), 1, r.data.size(), w.out);
+    fclose(w.out);
+    if (got != r.data.size()) return 0;
+    r.cache.reset();
+    for (size_t i = 0; i < n; i++) {
+        float dt;
+        int key;
+        uint32_t hash;
+        if (replayNext(r, dt, key, hash) != REPLAY_DT || floatBits(dt) != floatBits(dts[i])) return (long)i;
+    }
+    return r.pos == r.data.size() ? -1 : (long)n;
+}
@@ -0,0 +1,187 @@
+#pragma once
+// 时间线追踪：各线程把区段写进自己的无锁环形缓冲，按键或退出时导出成 Chrome trace_event JSON，
+// 可以直接拖进 Perfetto / chrome://tracing 查看。未开启时每个区段只读一次全局标志（没有局部静态变量的
+// 初始化检查），线程的缓冲在第一次记录事件时才分配。
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TRACE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define TRACE_UNLIKELY(x) (x)
+#endif
+
+#define TRACE_BUFFER_EVENTS (1 << 16)   // 每个线程的缓冲容量，必须是 2 的幂
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;     // 微秒
+    uint32_t dur;
+};
+
+// 单生产者（所属线程）单消费者（导出）的环形缓冲，写满时丢弃新事件
+struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> dropped{0};
+    int tid = 0;
+    const char* threadName = NULL;
+    bool nameWritten = false;
+};
+
+// 开关放在类模板的静态成员里：头文件里定义、整个程序只有一份，而且是常量初始化的，读的时候没有守卫
+template <typename T = void>
+struct TraceFlag {
+    static std::atomic<bool> enabled;
+};
+template <typename T>
+std::atomic<bool> TraceFlag<T>::enabled(false);
+
+inline bool traceEnabled() {
+    return TraceFlag<>::enabled.load(std::memory_order_relaxed);
+}
+
+struct TraceState {
+    std::mutex lock;                    // 只在注册线程和导出时使用
+    std::vector<TraceBuffer*> buffers;
+    FILE* out = NULL;
+    bool first = true;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline TraceState& traceState() {
+    static TraceState s;
+    return s;
+}
+
+inline uint64_t traceNow() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now() - traceState().epoch).count();
+}
+
+// 本线程的缓冲和名字；两者都是常量初始化的 thread_local，读取没有额外开销
+inline TraceBuffer*& traceThreadSlot() {
+    static thread_local TraceBuffer* buffer = NULL;
+    return buffer;
+}
+
+inline const char*& traceThreadName() {
+    static thread_local const char* name = NULL;
+    return name;
+}
+
+inline TraceBuffer* traceThreadBuffer() {
+    TraceBuffer*& buffer = traceThreadSlot();
+    if (TRACE_UNLIKELY(!buffer)) {
+        buffer = new TraceBuffer();     // 线程结束后仍保留，事件可以在之后导出
+        buffer->threadName = traceThreadName();
+        TraceState& s = traceState();
+        std::lock_guard<std::mutex> guard(s.lock);
+        buffer->tid = (int)s.buffers.size() + 1;
+        s.buffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+// 只记下名字，从不记录事件的线程不分配缓冲
+inline void traceSetThreadName(const char* name) {
+    traceThreadName() = name;
+    if (traceThreadSlot()) traceThreadSlot()->threadName = name;
+}
+
+inline void traceRecord(const char* name, uint64_t start, uint64_t end) {
+    TraceBuffer* b = traceThreadBuffer();
+    uint32_t h = b->head.load(std::memory_order_relaxed);
+    if (h - b->tail.load(std::memory_order_acquire) >= TRACE_BUFFER_EVENTS) {
+        b->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& e = b->events[h & (TRACE_BUFFER_EVENTS - 1)];
+    e.name = name;
+    e.start = start;
+    e.dur = (uint32_t)(end - start);
+    b->head.store(h + 1, std::memory_order_release);
+}
+
+struct TraceScope {
+    const char* name;
+    uint64_t start;
+    explicit TraceScope(const char* n) : name(NULL) {
+        if (TRACE_UNLIKELY(traceEnabled())) {
+            name = n;
+            start = traceNow();
+        }
+    }
+    // 只看构造时记下的 name，不再读全局标志
+    ~TraceScope() {
+        if (TRACE_UNLIKELY(name != NULL)) traceRecord(name, start, traceNow());
+    }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+// 使用 JSON 数组格式：结尾的 ']' 可以省略，进程中途崩溃时已经写出的部分仍然能打开
+inline bool traceStart(const char* path) {
+    TraceState& s = traceState();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (s.out) return false;
+    s.out = fopen(path, "w");
+    if (!s.out) {
+        printf("Trace: cannot open %s\n", path);
+        return false;
+    }
+    fputs("[\n", s.out);
+    s.first = true;
+    TraceFlag<>::enabled = true;
+    printf("Tracing to %s\n", path);
+    return true;
+}
+
+// 把各线程缓冲里已有的事件追加到文件
+inline void traceFlush() {
+    TraceState& s = traceState();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (!s.out) return;
+    size_t count = 0;
+    for (size_t i = 0; i < s.buffers.size(); i++) {
+        TraceBuffer* b = s.buffers[i];
+        if (b->threadName && !b->nameWritten) {
+            fprintf(s.out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    s.first ? "" : ",\n", b->tid, b->threadName);
+            s.first = false;
+            b->nameWritten = true;
+        }
+        uint32_t t = b->tail.load(std::memory_order_relaxed);
+        uint32_t h = b->head.load(std::memory_order_acquire);
+        for (; t != h; t++) {
+            const TraceEvent& e = b->events[t & (TRACE_BUFFER_EVENTS - 1)];
+            fprintf(s.out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%u}",
+                    s.first ? "" : ",\n", e.name, b->tid, (unsigned long long)e.start, e.dur);
+            s.first = false;
+            count++;
+        }
+        b->tail.store(t, std::memory_order_release);
+        uint32_t dropped = b->dropped.exchange(0);
+        if (dropped) printf("Trace: thread %d dropped %u events (buffer full)\n", b->tid, dropped);
+    }
+    fflush(s.out);
+    printf("Trace: flushed %zu events\n", count);
+}
+
+inline void traceStop() {
+    TraceState& s = traceState();
+    if (!s.out) return;
+    TraceFlag<>::enabled = false;
+    traceFlush();
+    std::lock_guard<std::mutex> guard(s.lock);
+    fputs("\n]\n", s.out);
+    fclose(s.out);
+    s.out = NULL;
+}